@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Allocation benchmarks. Each workload runs at 1, 2, 4, ... up to the given
+ * number of threads (from 2 for prodcons), in a fresh process so that its
+ * peak RSS is its own:
+ *
+ *   make bench
+ *   ./bench_fit1 label [max threads] [operations per thread]
+ *
+ * Built with BENCH_LIBC, the workloads use the C library's malloc() as a
+ * baseline.
+ *
+ * The fragmentation reported is the share of the heap that is free while
+ * the workload still holds its live blocks, from mallinfo2(). Mapped
+ * blocks are left out.
+ */
+
+#ifdef BENCH_LIBC
+
+#define MALLOC(size) malloc(size)
+#define FREE(ptr) free(ptr)
+#define REALLOC(ptr, size) realloc(ptr, size)
+#define MALLINFO2() mallinfo2()
+
+typedef struct mallinfo2 bench_info;
+
+#else
+
+#include "my_malloc.h"
+
+#define MALLOC(size) my_malloc(size)
+#define FREE(ptr) my_free(ptr)
+#define REALLOC(ptr, size) my_realloc(ptr, size)
+#define MALLINFO2() my_mallinfo2()
+
+typedef struct my_mallinfo2 bench_info;
+
+#endif
+
+#define MAX_THREADS (64)
+
+#define LARSON_SLOTS (1024)
+#define LARSON_ROUNDS (8)
+#define LARSON_MIN (16)
+#define LARSON_MAX (1024)
+
+#define QUEUE_SLOTS (1024)
+#define QUEUE_MIN (16)
+#define QUEUE_MAX (512)
+#define QUEUE_KEEP (8)
+
+#define CHURN_SLOTS (4096)
+#define CHURN_MAX_SHIFT (14)
+
+#define VECTORS (64)
+#define VECTOR_MAX (64 * 1024)
+#define VECTOR_STEP (256)
+
+/* The state of one benchmark thread */
+
+typedef struct worker {
+  pthread_t thread;
+  uint64_t rng;
+  size_t count;
+
+  /* Blocks the thread still holds when it finishes */
+
+  void **live;
+  size_t live_count;
+
+  /* The queue a producer fills and its consumer empties */
+
+  struct queue *queue;
+} worker;
+
+typedef struct queue {
+  void *slots[QUEUE_SLOTS];
+  size_t head;
+  size_t tail;
+} queue;
+
+static size_t g_ops = 200000;
+
+/*
+ * Returns the next number from a worker's xorshift generator.
+ */
+
+static uint64_t next_random(worker *w) {
+  w->rng ^= w->rng << 13;
+  w->rng ^= w->rng >> 7;
+  w->rng ^= w->rng << 17;
+  return w->rng;
+} /* next_random() */
+
+/*
+ * Allocates a block and writes to it, as a program would.
+ */
+
+static void *touch_malloc(size_t size) {
+  char *p = MALLOC(size);
+  if (p != NULL) {
+    p[0] = 1;
+    p[size - 1] = 1;
+  }
+  return p;
+} /* touch_malloc() */
+
+/*
+ * Larson server churn: each thread replaces random blocks in its slots.
+ * Between rounds the slots are handed to the next thread, which then frees
+ * blocks another thread allocated.
+ */
+
+static void *larson_thread(void *arg) {
+  worker *w = (worker *) arg;
+  for (size_t i = 0; i < g_ops / LARSON_ROUNDS; i++) {
+    size_t k = next_random(w) % LARSON_SLOTS;
+    FREE(w->live[k]);
+    w->live[k] = touch_malloc(LARSON_MIN +
+                              next_random(w) % (LARSON_MAX - LARSON_MIN));
+    w->count += 2;
+  }
+  return NULL;
+} /* larson_thread() */
+
+static void larson(worker *workers, size_t threads) {
+  for (size_t t = 0; t < threads; t++) {
+    workers[t].live = calloc(LARSON_SLOTS, sizeof(void *));
+    workers[t].live_count = LARSON_SLOTS;
+  }
+
+  for (size_t round = 0; round < LARSON_ROUNDS; round++) {
+    for (size_t t = 0; t < threads; t++) {
+      pthread_create(&workers[t].thread, NULL, larson_thread, &workers[t]);
+    }
+    for (size_t t = 0; t < threads; t++) {
+      pthread_join(workers[t].thread, NULL);
+    }
+
+    void **first = workers[0].live;
+    for (size_t t = 0; t + 1 < threads; t++) {
+      workers[t].live = workers[t + 1].live;
+    }
+    workers[threads - 1].live = first;
+  }
+} /* larson() */
+
+/*
+ * Producer/consumer: one thread of each pair allocates blocks and passes
+ * them through a queue to the other, which frees them. The consumer keeps
+ * one block in QUEUE_KEEP, so lifetimes are mixed. Runs from 2 threads,
+ * so that the count is always whole pairs.
+ */
+
+static void *producer_thread(void *arg) {
+  worker *w = (worker *) arg;
+  queue *q = w->queue;
+  for (size_t i = 0; i < g_ops / 2; i++) {
+    void *p = touch_malloc(QUEUE_MIN + next_random(w) % (QUEUE_MAX -
+                                                         QUEUE_MIN));
+    while (q->head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) ==
+           QUEUE_SLOTS) {
+      sched_yield();
+    }
+    q->slots[q->head % QUEUE_SLOTS] = p;
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+    w->count++;
+  }
+  return NULL;
+} /* producer_thread() */
+
+static void *consumer_thread(void *arg) {
+  worker *w = (worker *) arg;
+  queue *q = w->queue;
+  for (size_t i = 0; i < g_ops / 2; i++) {
+    while (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == q->tail) {
+      sched_yield();
+    }
+    void *p = q->slots[q->tail % QUEUE_SLOTS];
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+    if (i % QUEUE_KEEP == 0) {
+      w->live[w->live_count++] = p;
+    }
+    else {
+      FREE(p);
+      w->count++;
+    }
+  }
+  return NULL;
+} /* consumer_thread() */
+
+static void producer_consumer(worker *workers, size_t threads) {
+  size_t pairs = threads / 2;
+  queue *queues = calloc(pairs, sizeof(queue));
+
+  for (size_t t = 0; t < 2 * pairs; t++) {
+    workers[t].queue = &queues[t / 2];
+    if (t % 2 == 1) {
+      workers[t].live = calloc(g_ops / 2 / QUEUE_KEEP + 1, sizeof(void *));
+    }
+  }
+  for (size_t t = 0; t < 2 * pairs; t++) {
+    pthread_create(&workers[t].thread, NULL,
+                   t % 2 == 0 ? producer_thread : consumer_thread,
+                   &workers[t]);
+  }
+  for (size_t t = 0; t < 2 * pairs; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+} /* producer_consumer() */
+
+/*
+ * Fragmentation churn: random blocks are replaced with ones of a random
+ * size, spread evenly over powers of two up to 2^CHURN_MAX_SHIFT.
+ */
+
+static void *churn_thread(void *arg) {
+  worker *w = (worker *) arg;
+  for (size_t i = 0; i < g_ops / 2; i++) {
+    size_t k = next_random(w) % CHURN_SLOTS;
+    size_t shift = 3 + next_random(w) % (CHURN_MAX_SHIFT - 2);
+    size_t size = (1 << shift) + next_random(w) % (1 << shift);
+    FREE(w->live[k]);
+    w->live[k] = touch_malloc(size);
+    w->count += 2;
+  }
+  return NULL;
+} /* churn_thread() */
+
+static void churn(worker *workers, size_t threads) {
+  for (size_t t = 0; t < threads; t++) {
+    workers[t].live = calloc(CHURN_SLOTS, sizeof(void *));
+    workers[t].live_count = CHURN_SLOTS;
+  }
+  for (size_t t = 0; t < threads; t++) {
+    pthread_create(&workers[t].thread, NULL, churn_thread, &workers[t]);
+  }
+  for (size_t t = 0; t < threads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+} /* churn() */
+
+/*
+ * Realloc growth: vectors grow by a few bytes at a time, and start over
+ * once they reach VECTOR_MAX.
+ */
+
+static void *realloc_thread(void *arg) {
+  worker *w = (worker *) arg;
+  size_t sizes[VECTORS] = { 0 };
+  for (size_t i = 0; i < g_ops; i++) {
+    size_t k = next_random(w) % VECTORS;
+    if (sizes[k] >= VECTOR_MAX) {
+      FREE(w->live[k]);
+      w->live[k] = NULL;
+      sizes[k] = 0;
+    }
+    size_t size = sizes[k] + 1 + next_random(w) % VECTOR_STEP;
+    char *p = REALLOC(w->live[k], size);
+    if (p != NULL) {
+      memset(p + sizes[k], 1, size - sizes[k]);
+      w->live[k] = p;
+      sizes[k] = size;
+    }
+    w->count++;
+  }
+  return NULL;
+} /* realloc_thread() */
+
+static void realloc_growth(worker *workers, size_t threads) {
+  for (size_t t = 0; t < threads; t++) {
+    workers[t].live = calloc(VECTORS, sizeof(void *));
+    workers[t].live_count = VECTORS;
+  }
+  for (size_t t = 0; t < threads; t++) {
+    pthread_create(&workers[t].thread, NULL, realloc_thread, &workers[t]);
+  }
+  for (size_t t = 0; t < threads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+} /* realloc_growth() */
+
+typedef struct workload {
+  const char *name;
+  void (*run)(worker *workers, size_t threads);
+  size_t min_threads;
+} workload;
+
+static const workload g_workloads[] = {
+  { "larson", larson, 1 },
+  { "prodcons", producer_consumer, 2 },
+  { "churn", churn, 1 },
+  { "realloc", realloc_growth, 1 },
+};
+
+/*
+ * Runs a workload and prints its results. Called in a child process.
+ */
+
+static void run_workload(const char *label, const workload *load,
+                         size_t threads) {
+  worker workers[MAX_THREADS + 1];
+  memset(workers, 0, sizeof(workers));
+  for (size_t t = 0; t <= threads; t++) {
+    workers[t].rng = 0x9e3779b97f4a7c15ULL * (t + 1);
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  load->run(workers, threads);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) +
+                   (end.tv_nsec - start.tv_nsec) / 1e9;
+  size_t count = 0;
+  for (size_t t = 0; t <= threads; t++) {
+    count += workers[t].count;
+  }
+
+  bench_info info = MALLINFO2();
+  double fragmentation = info.arena == 0 ? 0.0 :
+                         100.0 * info.fordblks / info.arena;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("%-8s %-9s %3zu threads %12.0f ops/s %8ld KB peak %5.1f%% free\n",
+         label, load->name, threads, count / seconds, usage.ru_maxrss,
+         fragmentation);
+  fflush(stdout);
+
+  for (size_t t = 0; t <= threads; t++) {
+    for (size_t i = 0; i < workers[t].live_count; i++) {
+      FREE(workers[t].live[i]);
+    }
+  }
+} /* run_workload() */
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s label [max threads] [ops per thread]\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t max_threads = argc > 2 ? strtoul(argv[2], NULL, 10) : 4;
+  if (max_threads > MAX_THREADS) {
+    max_threads = MAX_THREADS;
+  }
+  if (argc > 3) {
+    g_ops = strtoul(argv[3], NULL, 10);
+  }
+
+  for (size_t i = 0; i < sizeof(g_workloads) / sizeof(workload); i++) {
+    for (size_t threads = g_workloads[i].min_threads;
+         threads <= max_threads; threads *= 2) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        run_workload(argv[1], &g_workloads[i], threads);
+        _exit(0);
+      }
+      waitpid(pid, NULL, 0);
+    }
+  }
+  return 0;
+} /* main() */
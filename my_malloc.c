@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include "my_malloc.h"
 
 #include <pthread.h>
@@ -8,604 +10,3897 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <fcntl.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* Pointer to the location of the heap prior to any sbrk calls */
 
 void *g_base = NULL;
 
-/* Pointer to the head of the free list */
+/*
+ * The heaps. Each arena's free lists hold the free blocks whose size maps to
+ * them through list_index(), and its mutex ensures thread safety for them.
+ *
+ * An arena's last_fence_post points to the second fencepost in the most
+ * recently allocated chunk from the OS. Used for coalescing chunks.
+ *
+ * An arena's next_allocate points to the next block in the freelist after
+ * the block that was last allocated. If the block pointed to is removed by
+ * coalescing, this shouuld be updated to point to the next block after the
+ * removed block.
+ */
 
-header *g_freelist_head = NULL;
+arena g_arenas[NUM_ARENAS];
 
-/* Mutex to ensure thread safety for the freelist */
+/* The arena this thread allocates from */
 
-static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread arena *t_arena = NULL;
 
-/*
- * Pointer to the second fencepost in the most recently allocated chunk from
- * the OS. Used for coalescing chunks
- */
+/* Counter used to spread threads across the arenas */
 
-header *g_last_fence_post = NULL;
+static size_t g_arena_counter = 0;
 
-/*
- * Pointer to the next block in the freelist after the block that was last
- * allocated. If the block pointed to is removed by coalescing, this shouuld be
- * updated to point to the next block after the removed block.
- */
+/* Times acquire_arena() tries a busy lock again before sleeping, 0 on a
+ * single CPU */
 
-header *g_next_allocate = NULL;
+static size_t g_lock_spins = 0;
 
-/*
- * Direct the compiler to run the init function before running main
- * this allows initialization of required globals
- */
+/* The growth policy, which my_mallopt() can change while other threads
+ * read it */
 
-static void init(void) __attribute__((constructor));
+static struct {
+  size_t percent;
+  size_t max;
+  size_t min;
+  size_t top_pad;
+} g_growth = { GROWTH_PERCENT, GROWTH_MAX, GROWTH_MIN, GROWTH_TOP_PAD };
 
-/*
- * Allocate the first available block able to satisfy the request
- * (starting the search at g_freelist_head)
- */
+#define GROWTH(field) __atomic_load_n(&g_growth.field, __ATOMIC_RELAXED)
 
-static header *first_fit(size_t size) {
-  header* current_block = g_freelist_head;
-  while (current_block != NULL) {
-    if (TRUE_SIZE(current_block) >= size) {
-      return current_block;
-    }
-    current_block = current_block->next;
-  }
-  return NULL;
-} /* first_fit() */
+#if MALLOC_STATS
 
-/*
- *  Allocate the first available block able to satisfy the request
- *  (starting the search at the next free header after the header that was most
- *  recently allocated)
- */
+/* Counters that are not tied to one arena */
 
-static header *next_fit(size_t size) {
-  header* current_block = g_next_allocate;
-  if (current_block == NULL) {
-    current_block = g_freelist_head;
-    if (current_block == NULL) {
-      return NULL;
-    }
-  }
+static struct {
+  size_t in_use;
+  size_t mapped_blocks;
+  size_t mapped_bytes;
+  size_t cached_blocks;
+  size_t cached_bytes;
+} g_stats;
 
-  header * starting_block = current_block;
+#define STAT_ADD(field, n) \
+  __atomic_fetch_add(&g_stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_SUB(field, n) \
+  __atomic_fetch_sub(&g_stats.field, (n), __ATOMIC_RELAXED)
+#define ARENA_STAT(a, field, n) ((a)->stats.field += (n))
 
-  do {
-    if (TRUE_SIZE(current_block) >= size) {
-      return current_block;
-    }
+#else
 
-    /* Iterate to the next block */
+#define STAT_ADD(field, n) ((void) 0)
+#define STAT_SUB(field, n) ((void) 0)
 
-    current_block = current_block->next;
-    if (current_block == NULL) {
-      current_block = g_freelist_head;
-    }
+/* Still uses the arena, which some functions take only for their stats */
 
-  } while (current_block != starting_block);
-  return NULL;
-} /* next_fit() */
+#define ARENA_STAT(a, field, n) ((void) (a))
 
-/*
- * Allocate the FIRST instance of the smallest block able to satisfy the
- * request
- */
+#endif
 
-static header *best_fit(size_t size) {
-  header *best_fit = g_freelist_head;
-  header *current_block = g_freelist_head;
-  while (current_block != NULL) {
-    size_t curr_size = TRUE_SIZE(current_block);
-    if ( curr_size >= size ) {
-      if (curr_size < best_fit->size) {
-        best_fit = current_block;
-      }
-    }
-    current_block = current_block->next;
-  }
-  if (best_fit->size >= size) {
-    return best_fit;
-  }
-  return NULL;
-} /* best_fit() */
+#if MALLOC_TRACE
 
-/*
- * This function finds the worst block to put the requested chunk of memory
- * in.
- */
+/* Calls this thread has made since its buffer was last written out */
 
-static header *worst_fit(size_t size) {
-  header *worst_fit = g_freelist_head;
-  header *current_block = g_freelist_head;
-  while (current_block != NULL) {
-    size_t curr_size = TRUE_SIZE(current_block);
-    if ( curr_size >= size ) {
-      if (curr_size >= worst_fit->size) {
-        worst_fit = current_block;
-      }
-    }
-    current_block = current_block->next;
-  }
+static __thread trace_record t_trace[TRACE_BUFFER_SIZE];
+static __thread size_t t_trace_count = 0;
 
-  if (worst_fit->size >= size) {
-    return worst_fit;
-  }
-  return NULL;
-} /* worst_fit() */
+/* This thread's number in the trace, assigned on its first call */
+
+static __thread uint32_t t_trace_thread = UINT32_MAX;
+
+/* Nonzero while a traced call is made from inside another, or while a
+ * record is being written */
+
+static __thread int t_trace_depth = 0;
+
+static uint32_t g_trace_threads = 0;
+static int g_trace_fd = -1;
+
+/* Key whose destructor writes out the buffer when a thread exits */
+
+static pthread_key_t g_trace_key;
 
 /*
- * Returns the address of the block to allocate
- * based on the specified algorithm.
- *
- * If no block is available, returns NULL.
+ * Appends this thread's records to the trace. A single write() with
+ * O_APPEND keeps the records of different threads from interleaving.
  */
 
-static header *find_header(size_t size) {
-  if (g_freelist_head == NULL) {
-    return NULL;
+static void trace_flush(void) {
+  if ((t_trace_count > 0) && (g_trace_fd >= 0)) {
+    ssize_t unused = write(g_trace_fd, t_trace,
+                           t_trace_count * sizeof(trace_record));
+    (void) unused;
   }
+  t_trace_count = 0;
+} /* trace_flush() */
 
-  switch (FIT_ALGORITHM) {
-    case 1:
-      return first_fit(size);
-    case 2:
-      return next_fit(size);
-    case 3:
-      return best_fit(size);
-    case 4:
-      return worst_fit(size);
-  }
-  assert(false);
-} /* find_header() */
+static void trace_release(void *unused) {
+  (void) unused;
+  trace_flush();
+} /* trace_release() */
 
 /*
- * Calculates the location of the left neighbor given a header.
+ * The main thread's buffer is written out when the program exits. Other
+ * threads still running lose what they have not written.
  */
 
-static inline header *left_neighbor(header *h) {
-  return (header *) (((char *) h) - h->left_size - ALLOC_HEADER_SIZE);
-} /* left_neighbor() */
+static void __attribute__((destructor)) trace_exit(void) {
+  trace_flush();
+} /* trace_exit() */
 
 /*
- * Calculates the location of the right neighbor given a header.
+ * A forked child stops tracing, since the blocks it inherits would appear
+ * under the parent's addresses.
  */
 
-static inline header *right_neighbor(header *h) {
-  return (header *) (((char *) h) + ALLOC_HEADER_SIZE + TRUE_SIZE(h));
-} /* right_neighbor() */
+static void trace_stop(void) {
+  t_trace_count = 0;
+  if (g_trace_fd >= 0) {
+    close(g_trace_fd);
+    g_trace_fd = -1;
+  }
+} /* trace_stop() */
 
 /*
- * Insert a block at the beginning of the freelist.
- * The block is located after its left header, h.
+ * Adds a call to this thread's buffer.
  */
 
-static void insert_free_block(header *h) {
-  h->prev = NULL;
+static void trace_call(trace_op op, void *ptr, void *old_ptr, size_t size) {
+  if ((t_trace_depth > 0) || (g_trace_fd < 0)) {
+    return;
+  }
+  t_trace_depth++;
 
-  if (h != g_freelist_head) {
-    if (g_freelist_head != NULL) {
-      g_freelist_head->prev = h;
-    }
+  if (t_trace_thread == UINT32_MAX) {
+    t_trace_thread = __atomic_fetch_add(&g_trace_threads, 1,
+                                        __ATOMIC_RELAXED);
+    pthread_setspecific(g_trace_key, t_trace);
+  }
 
-    h->next = g_freelist_head;
-    g_freelist_head = h;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  trace_record *r = &t_trace[t_trace_count++];
+  r->time = (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+  r->ptr = (uintptr_t) ptr;
+  r->old_ptr = (uintptr_t) old_ptr;
+  r->size = size;
+  r->thread = t_trace_thread;
+  r->op = op;
+
+  if (t_trace_count == TRACE_BUFFER_SIZE) {
+    trace_flush();
   }
+  t_trace_depth--;
+} /* trace_call() */
 
-} /* insert_free_block() */
+#define TRACE(op, ptr, old_ptr, size) trace_call(op, ptr, old_ptr, size)
 
-/*
- * Instantiates fenceposts at the left and right side of a block.
- */
+#else
 
-static void set_fenceposts(void *mem, size_t size) {
-  header *left_fence = (header *) mem;
-  header *right_fence = (header *) (((char *) mem) +
-                         (size - ALLOC_HEADER_SIZE));
+#define TRACE(op, ptr, old_ptr, size) ((void) 0)
 
-  left_fence->size = (state) FENCEPOST;
-  right_fence->size = (state) FENCEPOST;
+#endif
 
-  right_fence->left_size = size - 3 * ALLOC_HEADER_SIZE;
-} /* set_fenceposts() */
+static inline uint64_t read_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+} /* read_cycles() */
 
 /*
- * Constructor that runs before main() to initialize the library.
+ * Tells the CPU the thread is spinning, so it can yield to the other
+ * hyperthread and leave the memory bus alone.
  */
 
-static void init() {
-  g_freelist_head = NULL;
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+} /* cpu_relax() */
 
-  /* Initialize mutex for thread safety */
+#if MALLOC_LATENCY
 
-  pthread_mutex_init(&g_mutex, NULL);
+/* One thread's latency. The thread adds to its own counts, with atomics
+ * so that a reset from another thread is not lost */
 
-  /* Manually set printf buffer so it won't call malloc */
+typedef struct latency_histogram {
+  uint64_t counts[LATENCY_OPS][LATENCY_BUCKETS];
+  uint64_t max[LATENCY_OPS];
+  uint64_t events[LATENCY_EVENTS];
+  uint64_t event_cycles[LATENCY_EVENTS];
+  struct latency_histogram *next;
+  bool registered;
 
-  setvbuf(stdout, NULL, _IONBF, 0);
+  /* Set once the thread's counts were moved at exit. Calls made by later
+   * destructors are not counted, so that the histogram is not linked into
+   * g_latency_threads again after the thread is gone */
 
-  /* Record the starting address of the heap */
+  bool released;
+} latency_histogram;
 
-  g_base = sbrk(0);
-} /* init() */
+static __thread latency_histogram t_latency;
 
-/*
- * This function is used to determined if a header is unallocated or not.
- *
- * head: The header that is being checked;
- *
- * return: 0 is passed header is allocated, 1 if unallocated
- */
+/* The slow paths the current call has taken, one bit per event */
 
-static size_t isUnallocated(header * head) {
-  if (head == NULL) {
-    return 0;
-  }
+static __thread unsigned int t_latency_events = 0;
 
-  if (TRUE_SIZE(head) == head->size) {
-    return 1;
-  }
-  return 0;
-} /* isUnallocated() */
+/* Timed calls in progress, so that the calls one makes are not timed on
+ * their own */
 
-/*
- * This function will take a header with an appropirate amount of space
- * and split it to fit exactly that amount.
- *
- * head: The header that is to be split into a smaller size.
- * needed_size: The size that the header is going to be split to.
- *
- * return: A pointer to the split header with the correct size;
- */
+static __thread unsigned int t_latency_depth = 0;
 
-header* split_header(header* head, size_t needed_size) {
+/* The histograms of running threads, and the sum of those that exited,
+ * guarded by g_latency_mutex */
 
-  /* Set the next_allocate block for the next_fit function */
+static latency_histogram *g_latency_threads = NULL;
+static latency_histogram g_latency_exited;
+static pthread_mutex_t g_latency_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-  g_next_allocate = head->next;
+/* Key whose destructor moves a thread's counts to g_latency_exited */
 
-  /* If the size of the found_header is a perfect match or the remaining
-   * memory after splitting is too small */
+static pthread_key_t g_latency_key;
+
+/*
+ * Returns the bucket for a number of cycles. Values below
+ * 2^LATENCY_SUB_LOG2 have a bucket each; above that, each power of two is
+ * split by the bits below its top one.
+ */
 
-  if ((head->size == needed_size) ||
-      ((TRUE_SIZE(head) - needed_size - ALLOC_HEADER_SIZE) <=
-        ALLOC_HEADER_SIZE + sizeof(header *) * 2)) {
+static inline size_t latency_bucket(uint64_t cycles) {
+  if (cycles < (1 << LATENCY_SUB_LOG2)) {
+    return (size_t) cycles;
+  }
+  int top = 63 - __builtin_clzll(cycles);
+  return ((size_t) (top - LATENCY_SUB_LOG2 + 1) << LATENCY_SUB_LOG2) +
+         ((cycles >> (top - LATENCY_SUB_LOG2)) &
+          ((1 << LATENCY_SUB_LOG2) - 1));
+} /* latency_bucket() */
 
-    /* Remove head from the Free List */
+/*
+ * Returns the largest number of cycles that falls in a bucket.
+ */
 
-    if (head != g_freelist_head) {
-      head->prev->next = head->next;
-      if (head->next != NULL) {
-        head->next->prev = head->prev;
-      }
+static uint64_t latency_bucket_end(size_t bucket) {
+  if (bucket < (1 << LATENCY_SUB_LOG2)) {
+    return bucket;
+  }
+  int shift = (int) (bucket >> LATENCY_SUB_LOG2) - 1;
+  uint64_t start = ((uint64_t) (1 << LATENCY_SUB_LOG2) +
+                    (bucket & ((1 << LATENCY_SUB_LOG2) - 1))) << shift;
+  return start + ((uint64_t) 1 << shift) - 1;
+} /* latency_bucket_end() */
+
+static void latency_add(latency_histogram *to, latency_histogram *from) {
+  for (size_t op = 0; op < LATENCY_OPS; op++) {
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+      to->counts[op][i] += __atomic_load_n(&from->counts[op][i],
+                                           __ATOMIC_RELAXED);
     }
-    else {
-      g_freelist_head = head->next;
-      if (g_freelist_head != NULL) {
-        g_freelist_head->prev = NULL;
-      }
+    uint64_t max = __atomic_load_n(&from->max[op], __ATOMIC_RELAXED);
+    if (max > to->max[op]) {
+      to->max[op] = max;
     }
+  }
+  for (size_t i = 0; i < LATENCY_EVENTS; i++) {
+    to->events[i] += __atomic_load_n(&from->events[i], __ATOMIC_RELAXED);
+    to->event_cycles[i] += __atomic_load_n(&from->event_cycles[i],
+                                           __ATOMIC_RELAXED);
+  }
+} /* latency_add() */
 
-    head->next = NULL;
-    head->prev = NULL;
+/*
+ * Moves an exiting thread's counts to g_latency_exited.
+ */
 
-    return head;
+static void latency_release(void *unused) {
+  (void) unused;
+  pthread_mutex_lock(&g_latency_mutex);
+  latency_add(&g_latency_exited, &t_latency);
+  for (latency_histogram **h = &g_latency_threads; *h != NULL;
+       h = &(*h)->next) {
+    if (*h == &t_latency) {
+      *h = t_latency.next;
+      break;
+    }
   }
+  pthread_mutex_unlock(&g_latency_mutex);
+  t_latency.registered = false;
+  t_latency.released = true;
+} /* latency_release() */
 
-  /* Split the header */
+/*
+ * A forked child has only the thread that forked, so the others'
+ * histograms are dropped along with any hold they had on the mutex.
+ */
 
-  header* new_header = (header *) (((char *) head) +
-      ALLOC_HEADER_SIZE + needed_size);
-  new_header->size = TRUE_SIZE(head) - needed_size - ALLOC_HEADER_SIZE;
+static void latency_fork_child(void) {
+  pthread_mutex_init(&g_latency_mutex, NULL);
+  g_latency_threads = t_latency.registered ? &t_latency : NULL;
+  t_latency.next = NULL;
+} /* latency_fork_child() */
 
-  if (right_neighbor(head) != NULL) {
-    right_neighbor(head)->left_size = needed_size;
+static inline uint64_t latency_begin(void) {
+  if (t_latency_depth++ == 0) {
+    t_latency_events = 0;
   }
+  return read_cycles();
+} /* latency_begin() */
+
+/*
+ * Adds a call that started at start to this thread's histogram, and to
+ * the slow paths it took, unless it was made inside another timed call.
+ */
 
-  if (right_neighbor(new_header) != NULL) {
-    right_neighbor(new_header)->left_size = new_header->size;
+static void latency_record(latency_op op, uint64_t start) {
+  uint64_t cycles = read_cycles() - start;
+
+  if (--t_latency_depth != 0) {
+    return;
   }
 
-  if ((head != g_freelist_head) && (head->prev != NULL)) {
-    head->prev->next = head->next;
+  if (__builtin_expect(!t_latency.registered, 0)) {
+    if (t_latency.released) {
+      return;
+    }
+    t_latency.registered = true;
+    pthread_mutex_lock(&g_latency_mutex);
+    t_latency.next = g_latency_threads;
+    g_latency_threads = &t_latency;
+    pthread_mutex_unlock(&g_latency_mutex);
+    pthread_setspecific(g_latency_key, &t_latency);
   }
-  else {
-    g_freelist_head = head->next;
+
+  __atomic_fetch_add(&t_latency.counts[op][latency_bucket(cycles)], 1,
+                     __ATOMIC_RELAXED);
+  if (cycles > __atomic_load_n(&t_latency.max[op], __ATOMIC_RELAXED)) {
+    __atomic_store_n(&t_latency.max[op], cycles, __ATOMIC_RELAXED);
   }
 
-  if ((head->next != NULL) && (head->next != g_freelist_head)) {
-    head->next->prev = head->prev;
+  for (unsigned int events = t_latency_events; events != 0;
+       events &= events - 1) {
+    int event = __builtin_ctz(events);
+    __atomic_fetch_add(&t_latency.events[event], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&t_latency.event_cycles[event], cycles,
+                       __ATOMIC_RELAXED);
   }
+} /* latency_record() */
 
-  head->size = needed_size;
-  new_header->left_size = needed_size;
-  insert_free_block(new_header);
+#define LATENCY_EVENT(event) (t_latency_events |= 1U << (event))
 
-  head->next = NULL;
-  head->prev = NULL;
-  head->size = needed_size;
+#else
 
-  return new_header;
-} /* split_header() */
+#define LATENCY_EVENT(event) ((void) 0)
 
-/*
- * This function will round up a number to nearest multiple of another
- * number.
- *
- * num_to_round: This is the number that will be rounded up.
- * multiple: This is the multiple that the num_to_round will be rounded up to.
- *
- * return: The rounded up number.
- */
+#endif
 
-size_t roundup(size_t num_to_round, size_t multiple) {
-  if (num_to_round < multiple) {
-    num_to_round = multiple;
-  }
-  size_t difference = num_to_round % multiple;
-  if (difference != 0) {
-    num_to_round += (multiple - difference);
-  }
-  return num_to_round;
-} /* roundup() */
+#if THREAD_CACHE_SIZE > 0
 
 /*
- * This function is responsible for getting more space from the OS whenever
- * necessary.
- *
- * needed_mem_size: This is the amount of memory that is required from the
- *   my_malloc() call.
- *
- * return: A pointer to the header of the chunk of memory received.
+ * Blocks freed by this thread, kept for reuse without taking a lock. Class
+ * i holds blocks of at least MIN_BLOCK_SIZE + i * MIN_ALLOCATION bytes,
+ * singly linked through their next pointer. Cached blocks are marked CACHED,
+ * so their neighbors never coalesce with them.
  */
 
-header* get_more_mem(size_t needed_mem_size) {
+typedef struct thread_cache {
+  header *blocks[THREAD_CACHE_CLASSES];
+  size_t counts[THREAD_CACHE_CLASSES];
 
-  /* Request more memory from the OS */
+  /* Set once the thread's destructor is registered */
 
-  size_t size = ARENA_SIZE;
+  bool registered;
+} thread_cache;
 
-  while (size < needed_mem_size) {
-    size += ARENA_SIZE;
-  }
+static __thread thread_cache t_cache;
 
-  void* location = sbrk(size);
+/* Key whose destructor returns the cache to the heap when a thread exits */
 
-  /* Ensures that more mem was created */
+static pthread_key_t g_cache_key;
 
-  if (location == ((void *) -1)) {
-    errno = ENOMEM;
-    return NULL;
-  }
+static void cache_release(void *unused);
 
-  /* Set the fenceposts in the new chunk of mem */
+#endif
 
-  set_fenceposts(location, size);
+#if QUICK_LIST_CLASSES > 0
+static bool consolidate_quick(arena *a);
+#endif
 
-  /* Coalesce if needed */
+#if REMOTE_FREE
+static bool drain_remote(arena *a);
+#endif
 
-  if (g_base != location) {
+#if SLAB_MAX_SIZE > 0
 
-    /* If statement ensures that there has been more than one call to
-     * sbrk() so there should be multiple set of fenceposts. */
+/* Slab classes are MIN_ALLOCATION apart, class i holding objects of
+ * (i + 1) * MIN_ALLOCATION bytes */
 
-    header* possible_fencepost = location - ALLOC_HEADER_SIZE;
+#define SLAB_CLASSES ((SLAB_MAX_SIZE + MIN_ALLOCATION - 1) / MIN_ALLOCATION)
+#define BITMAP_BITS (8 * sizeof(size_t))
+#define SLAB_BITMAP_WORDS \
+  ((SLAB_SIZE / MIN_ALLOCATION + BITMAP_BITS - 1) / BITMAP_BITS)
 
-    if (possible_fencepost == g_last_fence_post) {
-      header* left_header = left_neighbor(g_last_fence_post);
+/*
+ * The start of a slab. Bit i of the bitmap is set if object i is free. A
+ * slab is on its class's list while it has free objects.
+ */
 
-      left_header->size = left_header->size + size;
-      g_last_fence_post = location + size - ALLOC_HEADER_SIZE;
-      return left_header;
-    }
-  }
+typedef struct slab {
+  struct slab *next;
+  struct slab *prev;
+  size_t object_size;
+  size_t capacity;
+  size_t free_count;
+  size_t bitmap[SLAB_BITMAP_WORDS];
+} slab;
 
-  /* Set the g_last_fencepost variable the most recent right fencepost */
+/* Objects start past the slab header, aligned like heap blocks */
 
-  g_last_fence_post = location + size - ALLOC_HEADER_SIZE;
+#define SLAB_HEADER_SIZE \
+  ((sizeof(slab) + sizeof(header) - 1) / sizeof(header) * sizeof(header))
 
-  /* Initialize the header in the new chunk */
+typedef struct slab_class {
+  pthread_mutex_t mutex;
+  slab *partial;
+} slab_class;
 
-  header* head = location + ALLOC_HEADER_SIZE;
-  head->size = size - 3 * ((size_t) ALLOC_HEADER_SIZE);
-  head->left_size = 0;
-  head->next = NULL;
-  head->prev = NULL;
-  head->data = NULL;
-  return head;
-} /* get_more_mem() */
+static slab_class g_slab_classes[SLAB_CLASSES];
 
-/*
- * This is my version of malloc().
- *
- * Allocates the requested memory to the user.
- */
+/* The region slabs are carved from, its bump pointer and the slabs that
+ * have been emptied, all guarded by g_slab_mutex */
 
-void *my_malloc(size_t requested_size) {
-  pthread_mutex_lock(&g_mutex);
+static char *g_slab_heap = NULL;
+static char *g_slab_top = NULL;
+static slab *g_empty_slabs = NULL;
+static pthread_mutex_t g_slab_mutex;
 
-  /* Make sure that NULL is returned when allocating no mem. */
+#endif
 
-  if (requested_size == 0) {
-    pthread_mutex_unlock(&g_mutex);
-    return NULL;
-  }
+/*
+ * Direct the compiler to run the init function before running main
+ * this allows initialization of required globals
+ */
 
-  /* Ensure that the requested size is a multiple of MIN_ALLOCATION */
+static void init(void) __attribute__((constructor));
 
-  requested_size = roundup(requested_size, MIN_ALLOCATION);
+/* Set once init() has run */
 
-  /* Ensure that there is enough space for next/prev pointers when this
-   * header is freed */
+static bool g_initialized = false;
 
-  requested_size = requested_size + ALLOC_HEADER_SIZE < sizeof(header) ?
-    sizeof(header) - ALLOC_HEADER_SIZE: requested_size;
+/*
+ * Free list links. With OFFSET_LINKS a link holds the offset of a block from
+ * the start of its arena's heap, and 0 ends the list: no free block starts
+ * there, since every chunk begins with a fencepost.
+ */
 
-  size_t needed_size = requested_size + ALLOC_HEADER_SIZE;
-  needed_size = roundup(needed_size, MIN_ALLOCATION);
+#if OFFSET_LINKS
 
-  /* Ensures that the amount of memory being allocated has enough room
-   * for two fenceposts and a header */
+#if ARENA_HEAP_SIZE > 0xFFFFFFFF
+#error "OFFSET_LINKS needs an ARENA_HEAP_SIZE below 4 GB"
+#endif
 
-  needed_size = requested_size + 3 * ALLOC_HEADER_SIZE > ARENA_SIZE ?
-    requested_size + 3 * ALLOC_HEADER_SIZE : needed_size;
+static inline char *link_base(arena *a) {
+  return a == &g_arenas[0] ? (char *) g_base : a->heap_start;
+} /* link_base() */
 
-  if ( g_freelist_head == NULL) {
-    header* newly_allocated_head = get_more_mem(needed_size);
+static inline header *link_to_header(arena *a, uint32_t link) {
+  return link == 0 ? NULL : (header *) (link_base(a) + link);
+} /* link_to_header() */
 
-    if (newly_allocated_head == NULL) {
-      return NULL;
-    }
+static inline uint32_t header_to_link(arena *a, header *h) {
+  return h == NULL ? 0 : (uint32_t) (((char *) h) - link_base(a));
+} /* header_to_link() */
 
-    g_freelist_head = newly_allocated_head;
-  }
+#define FREE_NEXT(a, h) (link_to_header((a), (h)->next_link))
+#define FREE_PREV(a, h) (link_to_header((a), (h)->prev_link))
+#define SET_FREE_NEXT(a, h, n) ((h)->next_link = header_to_link((a), (n)))
+#define SET_FREE_PREV(a, h, p) ((h)->prev_link = header_to_link((a), (p)))
+#else
+#define FREE_NEXT(a, h) ((h)->next)
+#define FREE_PREV(a, h) ((h)->prev)
+#define SET_FREE_NEXT(a, h, n) ((h)->next = (n))
+#define SET_FREE_PREV(a, h, p) ((h)->prev = (p))
+#endif
 
-  /* Look for a header with the proper contraints */
+#if FIT_ALGORITHM == 5
 
-  header* found_header = find_header(requested_size);
-  if (!found_header) {
-    header* new_chunk = get_more_mem(needed_size);
-    insert_free_block(new_chunk);
-    if (new_chunk == NULL) {
-      return NULL;
-    }
+/*
+ * Sizes below TLSF_SMALL_SIZE all share first level 0, split into
+ * MIN_ALLOCATION steps. Above it, each first level covers a power of two.
+ */
 
-    found_header = find_header(needed_size);
-  }
+#define TLSF_SMALL_SIZE (MIN_ALLOCATION * TLSF_SL_COUNT)
 
-  split_header(found_header, requested_size);
+/*
+ * Returns the index of the most significant bit set in a nonzero size.
+ */
 
-  /* Change the state of the found header to ALOOCATED */
+static inline size_t msb(size_t size) {
+  return sizeof(size_t) * 8 - 1 - __builtin_clzl(size);
+} /* msb() */
 
-  found_header->size = found_header->size | (state) ALLOCATED;
+/*
+ * Returns the index of the free list a block of the given size belongs to,
+ * that is first level * TLSF_SL_COUNT + second level.
+ */
 
-  pthread_mutex_unlock(&g_mutex);
-  return &found_header->data;
-} /* my_malloc() */
+static inline size_t list_index(size_t size) {
+  if (size < TLSF_SMALL_SIZE) {
+    return size / MIN_ALLOCATION;
+  }
+
+  size_t first = msb(size);
+  size_t second = (size >> (first - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+  first = first - msb(TLSF_SMALL_SIZE) + 1;
+  return first * TLSF_SL_COUNT + second;
+} /* list_index() */
 
 /*
- * TODO: implement free
+ * Returns the given size rounded up to the next list boundary. Every block in
+ * the list this size maps to is large enough for the original size.
  */
 
-void my_free(void *p) {
-  pthread_mutex_lock(&g_mutex);
+static inline size_t search_size(size_t size) {
+  if (size < TLSF_SMALL_SIZE) {
+    return (size + MIN_ALLOCATION - 1) & ~((size_t) MIN_ALLOCATION - 1);
+  }
 
-  if (p == NULL) {
-    pthread_mutex_unlock(&g_mutex);
-    return;
+  size_t step = (size_t) 1 << (msb(size) - TLSF_SL_LOG2);
+  return (size + step - 1) & ~(step - 1);
+} /* search_size() */
+
+/*
+ * Marks a list as non-empty in the bitmaps.
+ */
+
+static inline void tlsf_set_bit(arena *a, size_t list) {
+  a->tlsf_sl_bitmap[list / TLSF_SL_COUNT] |= 1U << (list % TLSF_SL_COUNT);
+  a->tlsf_fl_bitmap |= (size_t) 1 << (list / TLSF_SL_COUNT);
+} /* tlsf_set_bit() */
+
+/*
+ * Marks a list as empty in the bitmaps.
+ */
+
+static inline void tlsf_clear_bit(arena *a, size_t list) {
+  a->tlsf_sl_bitmap[list / TLSF_SL_COUNT] &= ~(1U << (list % TLSF_SL_COUNT));
+  if (a->tlsf_sl_bitmap[list / TLSF_SL_COUNT] == 0) {
+    a->tlsf_fl_bitmap &= ~((size_t) 1 << (list / TLSF_SL_COUNT));
   }
+} /* tlsf_clear_bit() */
 
-  header *head = (header *) (((char *) p) - ALLOC_HEADER_SIZE);
+/*
+ * Returns the head of the first non-empty list able to satisfy the request,
+ * found with two find-first-set operations. Any block in that list fits.
+ */
+
+static header *tlsf_fit(arena *a, size_t size) {
+  if (size > (SIZE_MAX >> 1)) {
+    return NULL;
+  }
 
-  /* Ensures that the block is not unallocated */
+  size_t list = list_index(search_size(size));
+  size_t first = list / TLSF_SL_COUNT;
 
-  if (isUnallocated(head)) {
-    pthread_mutex_unlock(&g_mutex);
-    assert(false);
-    exit(1);
+  if (first >= TLSF_FL_COUNT) {
+    return NULL;
+  }
+
+  unsigned int second_map = a->tlsf_sl_bitmap[first] &
+    (~0U << (list % TLSF_SL_COUNT));
+
+  if (second_map == 0) {
+
+    /* Nothing at this first level, move to the next non-empty one */
+
+    if (first + 1 >= TLSF_FL_COUNT) {
+      return NULL;
+    }
+
+    size_t first_map = a->tlsf_fl_bitmap & (~((size_t) 0) << (first + 1));
+    if (first_map == 0) {
+      return NULL;
+    }
+
+    first = __builtin_ctzl(first_map);
+    second_map = a->tlsf_sl_bitmap[first];
+  }
+
+  return a->freelists[first * TLSF_SL_COUNT + __builtin_ctz(second_map)];
+} /* tlsf_fit() */
+
+#else
+
+/*
+ * Returns the index of the free list a block of the given size belongs to.
+ *
+ * Every list but the last holds blocks within one MIN_ALLOCATION step,
+ * starting at the smallest block that can hold the free list pointers. The
+ * last list holds everything larger.
+ */
+
+static inline size_t list_index(size_t size) {
+#if N_LISTS == 1
+  (void) size;
+  return 0;
+#else
+  if (size < MIN_BLOCK_SIZE) {
+    return 0;
+  }
+
+  size_t index = (size - MIN_BLOCK_SIZE) / MIN_ALLOCATION;
+  return index < N_LISTS - 1 ? index : N_LISTS - 1;
+#endif
+} /* list_index() */
+
+/*
+ * Returns the smallest block size find_header() is guaranteed to accept for
+ * the given size.
+ */
+
+static inline size_t search_size(size_t size) {
+  return size;
+} /* search_size() */
+
+#endif
+
+#if FIT_ALGORITHM != 5
+
+/* Counts a free block looked at by a fit search, in the statistics and in
+ * the adaptive window, which does not depend on MALLOC_STATS */
+
+#define FIT_STEP(a) (ARENA_STAT(a, fit_steps, 1), (a)->window_steps++)
+
+/*
+ * Allocate the first available block able to satisfy the request
+ * (starting the search at the head of the list)
+ */
+
+static header *first_fit(arena *a, header *list, size_t size) {
+  header* current_block = list;
+  while (current_block != NULL) {
+    FIT_STEP(a);
+    if (TRUE_SIZE(current_block) >= size) {
+      return current_block;
+    }
+    current_block = FREE_NEXT(a, current_block);
   }
+  LATENCY_EVENT(LATENCY_FULL_SCAN);
+  return NULL;
+} /* first_fit() */
+
+/*
+ *  Allocate the first available block able to satisfy the request
+ *  (starting the search at the next free header after the header that was most
+ *  recently allocated, if that header lives in this list)
+ */
 
-  /* Change the state to Unallocated */
+static header *next_fit(arena *a, header *list, size_t size) {
+  header* current_block = list;
+  if ((a->next_allocate != NULL) &&
+      (list_index(TRUE_SIZE(a->next_allocate)) ==
+        list_index(TRUE_SIZE(list)))) {
+    current_block = a->next_allocate;
+  }
 
-  head->size = TRUE_SIZE(head);
+  header * starting_block = current_block;
 
-  if (isUnallocated(left_neighbor(head)) &&
-      isUnallocated(right_neighbor(head))) {
+  do {
+    FIT_STEP(a);
+    if (TRUE_SIZE(current_block) >= size) {
+      return current_block;
+    }
 
-    /* Coalesce with left and right neighbors */
+    /* Iterate to the next block */
 
-    if (right_neighbor(head) == g_next_allocate) {
-      g_next_allocate = left_neighbor(head);
+    current_block = FREE_NEXT(a, current_block);
+    if (current_block == NULL) {
+      current_block = list;
     }
 
-    size_t new_size = TRUE_SIZE(left_neighbor(head)) + TRUE_SIZE(head) +
-      TRUE_SIZE(right_neighbor(head)) + ALLOC_HEADER_SIZE * 2;
+  } while (current_block != starting_block);
+  LATENCY_EVENT(LATENCY_FULL_SCAN);
+  return NULL;
+} /* next_fit() */
 
-    /* This tests to see where to put the coalesced block in the free list */
+/*
+ * Allocate the FIRST instance of the smallest block able to satisfy the
+ * request
+ */
 
-    if (left_neighbor(head)->next == right_neighbor(head)) {
-      left_neighbor(head)->next = right_neighbor(head)->next;
-      if (left_neighbor(head)->next != NULL) {
-        left_neighbor(head)->next->left_size = new_size;
-        left_neighbor(head)->next->prev = left_neighbor(head);
+static header *best_fit(arena *a, header *list, size_t size) {
+  header *best_fit = NULL;
+  header *current_block = list;
+  while (current_block != NULL) {
+    FIT_STEP(a);
+    size_t curr_size = TRUE_SIZE(current_block);
+    if ( curr_size >= size ) {
+      if ((best_fit == NULL) || (curr_size < TRUE_SIZE(best_fit))) {
+        best_fit = current_block;
       }
     }
-    else {
-      if (right_neighbor(head)->prev != NULL) {
-        right_neighbor(head)->prev->next = left_neighbor(head);
+    current_block = FREE_NEXT(a, current_block);
+  }
+  LATENCY_EVENT(LATENCY_FULL_SCAN);
+  return best_fit;
+} /* best_fit() */
+
+/*
+ * This function finds the worst block to put the requested chunk of memory
+ * in.
+ */
+
+static header *worst_fit(arena *a, header *list, size_t size) {
+  header *worst_fit = NULL;
+  header *current_block = list;
+  while (current_block != NULL) {
+    FIT_STEP(a);
+    size_t curr_size = TRUE_SIZE(current_block);
+    if ( curr_size >= size ) {
+      if ((worst_fit == NULL) || (curr_size >= TRUE_SIZE(worst_fit))) {
+        worst_fit = current_block;
+      }
+    }
+    current_block = FREE_NEXT(a, current_block);
+  }
+  LATENCY_EVENT(LATENCY_FULL_SCAN);
+  return worst_fit;
+} /* worst_fit() */
+
+typedef header *(*fit_function)(arena *a, header *list, size_t size);
+
+/*
+ * Returns the first match of a fit function in the lists, starting at the
+ * one the request maps to. The lists are ordered by size, so the first list
+ * with a match holds the right block for every algorithm but worst fit.
+ * Inlined into each caller with a constant fit, so the search for each
+ * algorithm is compiled on its own.
+ */
+
+static inline header *search_lists(arena *a, size_t size, fit_function fit) {
+  for (size_t i = list_index(size); i < N_LISTS; i++) {
+    if (a->freelists[i] != NULL) {
+      header *found = fit(a, a->freelists[i], size);
+      if (found != NULL) {
+        return found;
       }
-      left_neighbor(head)->prev = right_neighbor(head)->prev;
     }
+  }
+  return NULL;
+} /* search_lists() */
+
+static header *find_first_fit(arena *a, size_t size) {
+  return search_lists(a, size, first_fit);
+} /* find_first_fit() */
+
+static header *find_next_fit(arena *a, size_t size) {
+  return search_lists(a, size, next_fit);
+} /* find_next_fit() */
 
-    left_neighbor(head)->size = new_size;
-    right_neighbor(head)->next = NULL;
-    right_neighbor(head)->prev = NULL;
+static header *find_best_fit(arena *a, size_t size) {
+  return search_lists(a, size, best_fit);
+} /* find_best_fit() */
+
+/*
+ * Worst fit searches from the largest list down.
+ */
+
+static header *find_worst_fit(arena *a, size_t size) {
+  for (size_t i = N_LISTS; i-- > list_index(size); ) {
+    if (a->freelists[i] != NULL) {
+      header *found = worst_fit(a, a->freelists[i], size);
+      if (found != NULL) {
+        return found;
+      }
+    }
   }
-  else if (isUnallocated(left_neighbor(head))) {
+  return NULL;
+} /* find_worst_fit() */
 
-    /* Coalesce with just the left neighbor  */
+#if (FIT_ALGORITHM < 1) || (FIT_ALGORITHM > 4)
+#error "FIT_ALGORITHM must be from 1 to 5"
+#endif
 
-    left_neighbor(head)->size = TRUE_SIZE(left_neighbor(head)) +
-      TRUE_SIZE(head) + ALLOC_HEADER_SIZE;
-    right_neighbor(head)->left_size = left_neighbor(head)->size;
+/* The searches, indexed by FIT_ALGORITHM */
+
+static header *(*const g_fit_searches[])(arena *a, size_t size) = {
+  NULL,
+  find_first_fit,
+  find_next_fit,
+  find_best_fit,
+  find_worst_fit,
+};
+
+#define FIT_SEARCHES (sizeof(g_fit_searches) / sizeof(g_fit_searches[0]))
+
+/*
+ * Restarts an arena's adaptive window.
+ */
+
+static void start_window(arena *a) {
+  a->window_searches = 0;
+  a->window_steps = 0;
+  a->window_misses = 0;
+} /* start_window() */
+
+/*
+ * Picks the fit algorithm of an adaptive arena from its last window of
+ * searches, as described with ADAPT_WINDOW.
+ */
+
+static void adapt_fit(arena *a) {
+  if (a->window_misses * 100 > a->window_searches * ADAPT_MISS_PERCENT) {
+    a->find = find_best_fit;
+  }
+  else if (a->window_steps > a->window_searches * ADAPT_MAX_STEPS) {
+    a->find = find_next_fit;
+  }
+  else {
+    a->find = find_first_fit;
   }
-  else if (isUnallocated(right_neighbor(head))) {
+  start_window(a);
+} /* adapt_fit() */
+
+/*
+ * Sets an arena's fit algorithm, 1-4 or FIT_ADAPTIVE. Its mutex must be
+ * held, or the arena not yet in use.
+ */
 
-    /* Coalesce with the right neighbor  */
+static void set_fit(arena *a, int fit) {
+  a->adaptive = (fit == FIT_ADAPTIVE);
+  a->find = a->adaptive ? find_first_fit : g_fit_searches[fit];
+  start_window(a);
+} /* set_fit() */
 
-    if (right_neighbor(head) == g_next_allocate) {
-      g_next_allocate = head;
+/*
+ * Parses a fit algorithm from MY_MALLOC_FIT: a number, or the algorithm's
+ * name. Returns -1 if it is neither.
+ */
+
+static int parse_fit(const char *value) {
+  const char *names[] = { "adaptive", "first", "next", "best", "worst" };
+  for (int i = 0; i < (int) FIT_SEARCHES; i++) {
+    if ((strcmp(value, names[i]) == 0) ||
+        ((value[0] == '0' + i) && (value[1] == '\0'))) {
+      return i;
     }
+  }
+  return -1;
+} /* parse_fit() */
+
+#endif
+
+/*
+ * Returns the address of the block to allocate, using the arena's fit
+ * algorithm.
+ *
+ * TLSF instead takes the head of the first non-empty list whose blocks all
+ * fit, without a search.
+ *
+ * If no block is available, returns NULL.
+ */
+
+static header *find_header(arena *a, size_t size) {
+  ARENA_STAT(a, fit_searches, 1);
 
-    head->next = right_neighbor(head)->next;
-    head->prev = right_neighbor(head)->prev;
+#if FIT_ALGORITHM == 5
+  ARENA_STAT(a, fit_steps, 1);
+  return tlsf_fit(a, size);
+#else
+  size_t steps = a->window_steps;
+  header *found = a->find(a, size);
 
-    if (right_neighbor(head)->next != NULL) {
-      right_neighbor(head)->next->left_size = head->size;
-      right_neighbor(head)->next->prev = head;
+  bool missed = (found == NULL) && (a->window_steps != steps);
+  if (missed) {
+    ARENA_STAT(a, fit_misses, 1);
+  }
+  if (a->adaptive) {
+    a->window_searches++;
+    a->window_misses += missed;
+    if (a->window_searches >= ADAPT_WINDOW) {
+      adapt_fit(a);
     }
+  }
+  return found;
+#endif
+} /* find_header() */
+
+/*
+ * Calculates the location of the left neighbor given a header. Compact
+ * headers only hold the left_size while PREV_INUSE is clear.
+ */
+
+static inline header *left_neighbor(header *h) {
+  return (header *) (((char *) h) - h->left_size - ALLOC_HEADER_SIZE);
+} /* left_neighbor() */
+
+/*
+ * Calculates the location of the right neighbor given a header.
+ */
+
+static inline header *right_neighbor(header *h) {
+  return (header *) (((char *) h) + ALLOC_HEADER_SIZE + TRUE_SIZE(h));
+} /* right_neighbor() */
+
+/*
+ * Sets the size of an existing block, keeping its PREV_INUSE bit.
+ */
+
+#define SET_SIZE(h, new_size) \
+  ((h)->size = (new_size) | ((h)->size & PREV_INUSE))
+
+/*
+ * Sets the state of a block that may have been handed out. A thread cache
+ * changes the state of its blocks without the arena's mutex, while the
+ * arena may flip their PREV_INUSE bits, so compact headers update the
+ * size atomically.
+ */
+
+static inline void set_state(header *h, state s) {
+#if COMPACT_HEADER
+  uint32_t old = __atomic_load_n(&h->size, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&h->size, &old,
+                                      (old & ~(uint32_t) 0b111) | s, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+#else
+  h->size = TRUE_SIZE(h) | s;
+#endif
+} /* set_state() */
+
+/*
+ * Records that the left neighbor of a block is unallocated or a fencepost
+ * of left_size bytes, so its left_size is valid.
+ */
+
+static inline void set_left_free(header *h, size_t left_size) {
+#if COMPACT_HEADER
+  __atomic_fetch_and(&h->size, ~PREV_INUSE, __ATOMIC_RELAXED);
+#endif
+  h->left_size = left_size;
+} /* set_left_free() */
+
+/*
+ * Records that the left neighbor of a block, of left_size bytes, is in use.
+ * A compact header leaves its left_size to the neighbor's data.
+ */
+
+static inline void set_left_used(header *h, size_t left_size) {
+#if COMPACT_HEADER
+  (void) left_size;
+  __atomic_fetch_or(&h->size, PREV_INUSE, __ATOMIC_RELAXED);
+#else
+  h->left_size = left_size;
+#endif
+} /* set_left_used() */
+
+/*
+ * Returns the number of bytes the caller may use in a block handed out,
+ * which runs into the right neighbor's left_size for heap blocks.
+ */
+
+static inline size_t usable_size(header *h) {
+  return STATE(h) == (state) MMAPPED ? TRUE_SIZE(h) :
+    TRUE_SIZE(h) + LEFT_SIZE_OVERLAP;
+} /* usable_size() */
+
+/*
+ * Returns the chunk after a chunk, from the link in the left_size of its
+ * left fencepost, or NULL for the arena's last chunk. Compact headers hold
+ * the distance to the next chunk rather than its address.
+ */
+
+static inline header *next_chunk(header *chunk) {
+#if COMPACT_HEADER
+  return chunk->left_size == 0 ? NULL :
+    (header *) (((char *) chunk) + chunk->left_size);
+#else
+  return (header *) chunk->left_size;
+#endif
+} /* next_chunk() */
+
+static inline void link_chunk(header *chunk, header *next) {
+#if COMPACT_HEADER
+  assert((size_t) ((char *) next - (char *) chunk) <= UINT32_MAX);
+  chunk->left_size = (char *) next - (char *) chunk;
+#else
+  chunk->left_size = (size_t) next;
+#endif
+} /* link_chunk() */
+
+/*
+ * Clears the words of a header that a block is coalescing over, if any of
+ * them lie in the arena's clean space, so that the clean space stays zero.
+ */
+
+static inline void clear_header(arena *a, header *h, size_t length) {
+  if (((char *) h) + length > a->clean) {
+    memset(h, 0, length);
+  }
+} /* clear_header() */
+
+/*
+ * Insert a block at the beginning of the free list matching its size.
+ * The block is located after its left header, h.
+ */
 
-    if (right_neighbor(head) == g_freelist_head) {
-      g_freelist_head = head;
+static void insert_free_block(arena *a, header *h) {
+  size_t index = list_index(TRUE_SIZE(h));
+  header **list = &a->freelists[index];
+
+  SET_FREE_PREV(a, h, NULL);
+
+  if (h != *list) {
+    if (*list != NULL) {
+      SET_FREE_PREV(a, *list, h);
     }
-    else if (head->prev != NULL) {
-      head->prev->next = head;
+
+    SET_FREE_NEXT(a, h, *list);
+    *list = h;
+  }
+
+#if FIT_ALGORITHM == 5
+  tlsf_set_bit(a, index);
+#endif
+
+  a->free_blocks++;
+  a->free_bytes += TRUE_SIZE(h);
+} /* insert_free_block() */
+
+/*
+ * Unlink a block from the free list it is in.
+ *
+ * list: The index of that free list. Passed in since callers that resized
+ *   the block already know which list it was filed under.
+ */
+
+static void remove_free_block(arena *a, header *h, size_t list) {
+  header *next = FREE_NEXT(a, h);
+  header *prev = FREE_PREV(a, h);
+
+  if (prev != NULL) {
+    SET_FREE_NEXT(a, prev, next);
+  }
+  else {
+    a->freelists[list] = next;
+
+#if FIT_ALGORITHM == 5
+    if (next == NULL) {
+      tlsf_clear_bit(a, list);
     }
+#endif
+  }
+
+  if (next != NULL) {
+    SET_FREE_PREV(a, next, prev);
+  }
+
+  SET_FREE_NEXT(a, h, NULL);
+  SET_FREE_PREV(a, h, NULL);
+
+  a->free_blocks--;
+  a->free_bytes -= TRUE_SIZE(h);
+} /* remove_free_block() */
+
+/*
+ * Give new_block the position old_block has in its free list.
+ * new_block must belong in the same list as old_block.
+ */
 
-    head->size = head->size + ALLOC_HEADER_SIZE +
-      TRUE_SIZE(right_neighbor(head));
+static void replace_free_block(arena *a, header *old_block,
+                               header *new_block) {
+  header *next = FREE_NEXT(a, old_block);
+  header *prev = FREE_PREV(a, old_block);
+  SET_FREE_NEXT(a, new_block, next);
+  SET_FREE_PREV(a, new_block, prev);
+
+  if (prev != NULL) {
+    SET_FREE_NEXT(a, prev, new_block);
   }
   else {
+    a->freelists[list_index(TRUE_SIZE(new_block))] = new_block;
+  }
 
-    /* Neither neighbor is unallocated, so just add to free list */
+  if (next != NULL) {
+    SET_FREE_PREV(a, next, new_block);
+  }
 
-    insert_free_block(head);
+  if (a->next_allocate == old_block) {
+    a->next_allocate = new_block;
   }
-  pthread_mutex_unlock(&g_mutex);
-} /* my_free() */
+
+  a->free_bytes -= TRUE_SIZE(old_block);
+  a->free_bytes += TRUE_SIZE(new_block);
+} /* replace_free_block() */
 
 /*
- * Calls malloc and sets each byte of
- * the allocated memory to a value.
+ * Sets the size of a block that stays on a free list.
  */
 
-void *my_calloc(size_t nmemb, size_t size) {
-  return memset(my_malloc(size * nmemb), 0, size * nmemb);
-} /* my_calloc() */
+static inline void resize_free_block(arena *a, header *h, size_t size) {
+  a->free_bytes -= TRUE_SIZE(h);
+  a->free_bytes += size;
+  SET_SIZE(h, size);
+} /* resize_free_block() */
 
 /*
- * Reallocates an allocated block to a new size and
- * copies the contents to the new block.
+ * Move a free block that changed size from the list at old_list to the list
+ * matching its new size. The block keeps its position if the list is the
+ * same.
  */
 
-void *my_realloc(void *ptr, size_t size) {
-  void *mem = my_malloc(size);
-  memcpy(mem, ptr, size);
-  my_free(ptr);
-  return mem;
-} /* my_realloc() */
+static void refile_free_block(arena *a, header *h, size_t old_list) {
+  if (list_index(TRUE_SIZE(h)) != old_list) {
+    remove_free_block(a, h, old_list);
+    insert_free_block(a, h);
+  }
+} /* refile_free_block() */
+
+/*
+ * Instantiates fenceposts at the left and right side of a block.
+ */
+
+static void set_fenceposts(void *mem, size_t size) {
+  header *left_fence = (header *) mem;
+  header *right_fence = (header *) (((char *) mem) +
+                         (size - ALLOC_HEADER_SIZE));
+
+  left_fence->size = (state) FENCEPOST;
+  right_fence->size = (state) FENCEPOST;
+
+  set_left_free(right_fence, size - 3 * ALLOC_HEADER_SIZE);
+} /* set_fenceposts() */
+
+/*
+ * Fork handlers. Every lock is taken before a fork, so the child never
+ * inherits a heap that another thread was in the middle of changing. The
+ * parent releases them, the child (whose only thread is the forking one)
+ * starts over with fresh locks.
+ */
+
+static void lock_all(void) {
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    pthread_mutex_lock(&g_arenas[i].mutex);
+  }
+#if SLAB_MAX_SIZE > 0
+  for (size_t i = 0; i < SLAB_CLASSES; i++) {
+    pthread_mutex_lock(&g_slab_classes[i].mutex);
+  }
+  pthread_mutex_lock(&g_slab_mutex);
+#endif
+} /* lock_all() */
+
+static void unlock_all(void) {
+#if SLAB_MAX_SIZE > 0
+  pthread_mutex_unlock(&g_slab_mutex);
+  for (size_t i = 0; i < SLAB_CLASSES; i++) {
+    pthread_mutex_unlock(&g_slab_classes[i].mutex);
+  }
+#endif
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    pthread_mutex_unlock(&g_arenas[i].mutex);
+  }
+} /* unlock_all() */
+
+static void reset_locks(void) {
+#if SLAB_MAX_SIZE > 0
+  pthread_mutex_init(&g_slab_mutex, NULL);
+  for (size_t i = 0; i < SLAB_CLASSES; i++) {
+    pthread_mutex_init(&g_slab_classes[i].mutex, NULL);
+  }
+#endif
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    pthread_mutex_init(&g_arenas[i].mutex, NULL);
+  }
+} /* reset_locks() */
+
+/*
+ * Constructor that runs before main() to initialize the library.
+ */
+
+static void init() {
+  if (g_initialized) {
+    return;
+  }
+  g_initialized = true;
+
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    for (size_t j = 0; j < N_LISTS; j++) {
+      g_arenas[i].freelists[j] = NULL;
+    }
+    g_arenas[i].free_blocks = 0;
+    g_arenas[i].free_bytes = 0;
+
+    /* Initialize mutex for thread safety */
+
+    pthread_mutex_init(&g_arenas[i].mutex, NULL);
+  }
+
+#if SLAB_MAX_SIZE > 0
+  for (size_t i = 0; i < SLAB_CLASSES; i++) {
+    g_slab_classes[i].partial = NULL;
+    pthread_mutex_init(&g_slab_classes[i].mutex, NULL);
+  }
+  pthread_mutex_init(&g_slab_mutex, NULL);
+#endif
+
+#ifndef MALLOC_PRELOAD
+
+  /* Manually set printf buffer so it won't call malloc */
+
+  setvbuf(stdout, NULL, _IONBF, 0);
+#endif
+
+  /* Record the starting address of the heap */
+
+  g_base = sbrk(0);
+
+  /* Spinning on a lock only helps if its holder can run meanwhile */
+
+  if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+    g_lock_spins = LOCK_SPIN_LIMIT;
+  }
+
+#if THREAD_CACHE_SIZE > 0
+  pthread_key_create(&g_cache_key, cache_release);
+#endif
+
+#if FIT_ALGORITHM != 5
+  const char *fit_name = getenv("MY_MALLOC_FIT");
+  int fit = fit_name != NULL ? parse_fit(fit_name) : -1;
+  if (fit < 0) {
+    fit = FIT_ALGORITHM;
+  }
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    set_fit(&g_arenas[i], fit);
+  }
+#endif
+
+  pthread_atfork(lock_all, unlock_all, reset_locks);
+
+#if MALLOC_TRACE
+  const char *trace_file = getenv("MY_MALLOC_TRACE");
+  g_trace_fd = open(trace_file != NULL ? trace_file : MALLOC_TRACE_FILE,
+                    O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  pthread_key_create(&g_trace_key, trace_release);
+  pthread_atfork(NULL, NULL, trace_stop);
+#endif
+
+#if MALLOC_LATENCY
+  pthread_key_create(&g_latency_key, latency_release);
+  pthread_atfork(NULL, NULL, latency_fork_child);
+#endif
+} /* init() */
+
+/*
+ * Runs init() if an allocation arrives before the constructor, such as one
+ * made by the dynamic loader when the allocator is preloaded.
+ */
+
+static inline void ensure_init(void) {
+  if (__builtin_expect(!g_initialized, 0)) {
+    init();
+  }
+} /* ensure_init() */
+
+/*
+ * This function is used to determined if a header is unallocated or not.
+ *
+ * head: The header that is being checked;
+ *
+ * return: 0 is passed header is allocated, 1 if unallocated
+ */
+
+static size_t isUnallocated(header * head) {
+  if (head == NULL) {
+    return 0;
+  }
+
+  if (STATE(head) == (state) UNALLOCATED) {
+    return 1;
+  }
+  return 0;
+} /* isUnallocated() */
+
+/*
+ * Returns the left neighbor of a block if it is unallocated, or NULL.
+ */
+
+static inline header *free_left_neighbor(header *h) {
+  if (h->size & PREV_INUSE) {
+    return NULL;
+  }
+
+  header *left = left_neighbor(h);
+  return isUnallocated(left) ? left : NULL;
+} /* free_left_neighbor() */
+
+/*
+ * This function will take a header with an appropirate amount of space
+ * and split it to fit exactly that amount.
+ *
+ * head: The header that is to be split into a smaller size.
+ * needed_size: The size that the header is going to be split to.
+ *
+ * return: A pointer to the split header with the correct size;
+ */
+
+header* split_header(arena *a, header* head, size_t needed_size) {
+  size_t old_list = list_index(TRUE_SIZE(head));
+
+  /* Set the next_allocate block for the next_fit function */
+
+  a->next_allocate = FREE_NEXT(a, head);
+
+  /* If the size of the found_header is a perfect match or the remaining
+   * memory after splitting is too small */
+
+  if ((TRUE_SIZE(head) == needed_size) ||
+      (TRUE_SIZE(head) <= needed_size + 2 * ALLOC_HEADER_SIZE +
+        MIN_BLOCK_SIZE)) {
+
+    /* Remove head from the Free List */
+
+    remove_free_block(a, head, old_list);
+    return head;
+  }
+
+  /* Split the header. The remainder takes over head's spot in the free
+   * list if it still belongs in the same list. */
+
+  ARENA_STAT(a, splits, 1);
+
+  header* new_header = (header *) (((char *) head) +
+      ALLOC_HEADER_SIZE + needed_size);
+  new_header->size = TRUE_SIZE(head) - needed_size - ALLOC_HEADER_SIZE;
+  set_left_used(new_header, needed_size);
+  set_left_free(right_neighbor(new_header), TRUE_SIZE(new_header));
+
+  if (list_index(TRUE_SIZE(new_header)) == old_list) {
+    replace_free_block(a, head, new_header);
+  }
+  else {
+    remove_free_block(a, head, old_list);
+    insert_free_block(a, new_header);
+  }
+
+  SET_FREE_NEXT(a, head, NULL);
+  SET_FREE_PREV(a, head, NULL);
+  SET_SIZE(head, needed_size);
+
+  return new_header;
+} /* split_header() */
+
+/*
+ * This function will round up a number to nearest multiple of another
+ * number.
+ *
+ * num_to_round: This is the number that will be rounded up.
+ * multiple: This is the multiple that the num_to_round will be rounded up to.
+ *
+ * return: The rounded up number.
+ */
+
+size_t roundup(size_t num_to_round, size_t multiple) {
+  if (num_to_round < multiple) {
+    num_to_round = multiple;
+  }
+  size_t difference = num_to_round % multiple;
+  if (difference != 0) {
+    num_to_round += (multiple - difference);
+  }
+  return num_to_round;
+} /* roundup() */
+
+/*
+ * Maps size bytes aligned to size, so that the start of the region can be
+ * found by masking the address of anything in it.
+ *
+ * return: The region, or NULL if mmap() failed.
+ */
+
+static char *map_aligned(size_t size) {
+
+  /* Map twice the size so an aligned region fits, then trim the rest */
+
+  char *mem = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+
+  char *start = (char *) (((uintptr_t) mem + size - 1) &
+                          ~((uintptr_t) size - 1));
+  if (start != mem) {
+    munmap(mem, start - mem);
+  }
+  munmap(start + size, mem + size - start);
+  return start;
+} /* map_aligned() */
+
+/*
+ * Extends an arena's heap. Arena 0 uses sbrk(), the other arenas carve the
+ * space out of their mmap() region, which is mapped on first use.
+ *
+ * return: The start of the new space, or (void *) -1 if there is none.
+ */
+
+static void *arena_sbrk(arena *a, size_t size) {
+  if (a == &g_arenas[0]) {
+#if OFFSET_LINKS
+
+    /* Free list links only reach 4 GB past the start of the heap */
+
+    if ((uint64_t) (((char *) sbrk(0)) - ((char *) g_base)) + size >
+        UINT32_MAX) {
+      return (void *) -1;
+    }
+#endif
+    return sbrk(size);
+  }
+
+  if (a->heap_start == NULL) {
+    char *start = map_aligned(ARENA_HEAP_SIZE);
+    if (start == NULL) {
+      return (void *) -1;
+    }
+
+    a->heap_top = start;
+    __atomic_store_n(&a->heap_start, start, __ATOMIC_RELEASE);
+  }
+
+  if (size > (size_t) (a->heap_start + ARENA_HEAP_SIZE - a->heap_top)) {
+    return (void *) -1;
+  }
+
+  void *location = a->heap_top;
+  a->heap_top += size;
+  return location;
+} /* arena_sbrk() */
+
+/* Largest a chunk may grow by coalescing with the space after it. Compact
+ * headers hold sizes in 31 bits below PREV_INUSE, so no block can be larger */
+
+#if COMPACT_HEADER
+#define MAX_CHUNK_SIZE ((size_t) PREV_INUSE - 1)
+#else
+#define MAX_CHUNK_SIZE (SIZE_MAX)
+#endif
+
+/*
+ * Decides how much an arena grows by to fit needed bytes: the request plus
+ * the top pad, at least the minimum growth, and with geometric growth on,
+ * at least GROWTH_PERCENT of the arena's last growth up to the cap.
+ *
+ * return: The size, a multiple of ARENA_SIZE.
+ */
+
+static size_t growth_size(arena *a, size_t needed) {
+  size_t size = needed + GROWTH(top_pad);
+  if (size < GROWTH(min)) {
+    size = GROWTH(min);
+  }
+
+  size_t percent = GROWTH(percent);
+  if ((percent > 100) && (a->last_growth != 0)) {
+    size_t max = GROWTH(max);
+    size_t geometric = a->last_growth >= max / percent * 100 ? max :
+                       a->last_growth / 100 * percent;
+    if (size < geometric) {
+      size = geometric;
+    }
+  }
+  return roundup(size, ARENA_SIZE);
+} /* growth_size() */
+
+/*
+ * The free space at the top of an arena that makes free_block() trim it.
+ * It is at least as large as the arena's next growth would be, so that a
+ * heap does not give back memory it is about to ask for again.
+ */
+
+static size_t trim_threshold(arena *a) {
+  size_t threshold = TRIM_THRESHOLD;
+  if (threshold < GROWTH(min) + GROWTH(top_pad)) {
+    threshold = GROWTH(min) + GROWTH(top_pad);
+  }
+  if ((GROWTH(percent) > 100) && (threshold < a->last_growth)) {
+    threshold = a->last_growth;
+  }
+  return threshold;
+} /* trim_threshold() */
+
+/*
+ * This function is responsible for getting more space from the OS whenever
+ * necessary.
+ *
+ * a: The arena to grow. Its mutex must be held.
+ * needed_mem_size: This is the amount of memory that is required from the
+ *   my_malloc() call.
+ *
+ * return: A pointer to the header of the chunk of memory received. The chunk
+ *   is already in the free list.
+ */
+
+header* get_more_mem(arena *a, size_t needed_mem_size) {
+
+  /* Request more memory from the OS, falling back to just what is needed
+   * if the policy's size is not available */
+
+  size_t size = growth_size(a, needed_mem_size);
+  void* location = arena_sbrk(a, size);
+  ARENA_STAT(a, grow_calls, 1);
+
+  if ((location == ((void *) -1)) &&
+      (size > roundup(needed_mem_size, ARENA_SIZE))) {
+    size = roundup(needed_mem_size, ARENA_SIZE);
+    location = arena_sbrk(a, size);
+    ARENA_STAT(a, grow_calls, 1);
+  }
+
+  /* Ensures that more mem was created */
+
+  if (location == ((void *) -1)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  a->last_growth = size;
+  ARENA_STAT(a, os_requests, 1);
+  ARENA_STAT(a, os_bytes, size);
+  LATENCY_EVENT(LATENCY_SBRK);
+
+  /* Set the fenceposts in the new chunk of mem */
+
+  set_fenceposts(location, size);
+
+  /* Coalesce if the new chunk directly follows the arena's last chunk */
+
+  header* possible_fencepost = location - ALLOC_HEADER_SIZE;
+
+  if ((possible_fencepost == a->last_fence_post) &&
+      ((size_t) (((char *) location) + size - ((char *) a->last_chunk)) <=
+       MAX_CHUNK_SIZE)) {
+    header* left_header = free_left_neighbor(a->last_fence_post);
+    a->last_fence_post = location + size - ALLOC_HEADER_SIZE;
+
+    if (left_header != NULL) {
+
+      /* Grow the last free block over both fenceposts */
+
+      clear_header(a, possible_fencepost, ALLOC_HEADER_SIZE);
+      clear_header(a, location, ALLOC_HEADER_SIZE);
+      ARENA_STAT(a, coalesces, 1);
+
+      size_t old_list = list_index(TRUE_SIZE(left_header));
+      resize_free_block(a, left_header, TRUE_SIZE(left_header) + size);
+      set_left_free(a->last_fence_post, TRUE_SIZE(left_header));
+      refile_free_block(a, left_header, old_list);
+      return left_header;
+    }
+
+    /* The last block is allocated, so the old right fencepost becomes the
+     * header of the new space */
+
+    SET_SIZE(possible_fencepost, size - ALLOC_HEADER_SIZE);
+    set_left_free(a->last_fence_post, TRUE_SIZE(possible_fencepost));
+    insert_free_block(a, possible_fencepost);
+    return possible_fencepost;
+  }
+
+  /* Set the last_fence_post variable the most recent right fencepost */
+
+  a->last_fence_post = location + size - ALLOC_HEADER_SIZE;
+
+  /* Initialize the header in the new chunk */
+
+  header* head = location + ALLOC_HEADER_SIZE;
+  head->size = size - 3 * ((size_t) ALLOC_HEADER_SIZE);
+  head->left_size = 0;
+  insert_free_block(a, head);
+
+  /* Link the chunk after the arena's last one */
+
+  header *chunk = (header *) location;
+  chunk->left_size = 0;
+  if (a->last_chunk == NULL) {
+    a->first_chunk = chunk;
+  }
+  else {
+    link_chunk(a->last_chunk, chunk);
+  }
+  a->last_chunk = chunk;
+  return head;
+} /* get_more_mem() */
+
+/*
+ * Gives the free space at the top of an arena back to the OS, keeping pad
+ * bytes of it. Arena 0 shrinks the break with a negative sbrk(), the other
+ * arenas lower their region's top and drop the pages with madvise(). The
+ * space is released in ARENA_SIZE steps and the right fencepost is rewritten
+ * at the new end. The arena's mutex must be held.
+ *
+ * return: The number of bytes released.
+ */
+
+static size_t trim_arena(arena *a, size_t pad) {
+  if (a->last_fence_post == NULL) {
+    return 0;
+  }
+
+  header *top = free_left_neighbor(a->last_fence_post);
+  char *end = ((char *) a->last_fence_post) + ALLOC_HEADER_SIZE;
+
+  if ((top == NULL) || (TRUE_SIZE(top) < pad + MIN_BLOCK_SIZE)) {
+    return 0;
+  }
+
+  size_t release = TRUE_SIZE(top) - pad - MIN_BLOCK_SIZE;
+  release -= release % ARENA_SIZE;
+  if (release == 0) {
+    return 0;
+  }
+
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  char *first_page = (char *) roundup((uintptr_t) (end - release), page_size);
+
+  if (a == &g_arenas[0]) {
+
+    /* Only shrink the break if nothing else has moved it past the heap */
+
+    if ((sbrk(0) != end) || (sbrk(-((intptr_t) release)) == (void *) -1)) {
+      return 0;
+    }
+  }
+  else {
+    if (first_page < end) {
+      madvise(first_page, end - first_page, MADV_DONTNEED);
+    }
+    a->heap_top = end - release;
+  }
+
+  /* The page holding the new end keeps its contents, so the old fencepost
+   * must not be left in the clean space */
+
+  if ((char *) a->last_fence_post < first_page) {
+    clear_header(a, a->last_fence_post, ALLOC_HEADER_SIZE);
+  }
+
+  ARENA_STAT(a, os_bytes, -release);
+  ARENA_STAT(a, trims, 1);
+
+  size_t old_list = list_index(TRUE_SIZE(top));
+  resize_free_block(a, top, TRUE_SIZE(top) - release);
+
+  a->last_fence_post = right_neighbor(top);
+  a->last_fence_post->size = (state) FENCEPOST;
+  set_left_free(a->last_fence_post, TRUE_SIZE(top));
+
+  refile_free_block(a, top, old_list);
+  return release;
+} /* trim_arena() */
+
+/*
+ * Rounds a requested size up to the size of the block that will hold it.
+ *
+ * requested_size: The size passed to my_malloc(), at most MAX_REQUEST.
+ *
+ * return: The block size, a multiple of MIN_ALLOCATION large enough to hold
+ *   the free list pointers once the block is freed.
+ */
+
+static size_t block_size(size_t requested_size) {
+
+  /* The right neighbor's left_size holds the last bytes of the data */
+
+  requested_size = requested_size > LEFT_SIZE_OVERLAP ?
+    requested_size - LEFT_SIZE_OVERLAP : 0;
+
+  /* Ensure that the requested size is a multiple of MIN_ALLOCATION */
+
+  requested_size = roundup(requested_size, MIN_ALLOCATION);
+
+  /* Ensure that there is enough space for next/prev pointers when this
+   * header is freed */
+
+  return requested_size + ALLOC_HEADER_SIZE < sizeof(header) ?
+    sizeof(header) - ALLOC_HEADER_SIZE: requested_size;
+} /* block_size() */
+
+#if QUICK_LIST_CLASSES > 0
+
+/*
+ * Returns the quick list a free block of the given size is filed under.
+ */
+
+static inline size_t quick_class(size_t size) {
+  return (size - MIN_BLOCK_SIZE) / MIN_ALLOCATION;
+} /* quick_class() */
+
+/*
+ * Pops a block from the first quick list whose blocks are all large enough
+ * for the request. The arena's mutex must be held.
+ *
+ * return: The block, marked ALLOCATED, or NULL if the list is empty.
+ */
+
+static header *quick_malloc(arena *a, size_t size) {
+  size_t class = (size - MIN_BLOCK_SIZE + MIN_ALLOCATION - 1) /
+    MIN_ALLOCATION;
+  header *head = a->quick[class];
+  if (head == NULL) {
+    return NULL;
+  }
+
+  a->quick[class] = head->next;
+  a->quick_blocks--;
+  a->quick_bytes -= TRUE_SIZE(head);
+  ARENA_STAT(a, quick_hits, 1);
+  STAT_SUB(cached_blocks, 1);
+  STAT_SUB(cached_bytes, TRUE_SIZE(head));
+
+  set_state(head, (state) ALLOCATED);
+  return head;
+} /* quick_malloc() */
+
+#endif
+
+/*
+ * Takes a block from an arena's quick lists or free lists, asking the OS
+ * for more memory if none fits. The arena's mutex must be held.
+ *
+ * requested_size: The block size, as returned by block_size().
+ * dirty: If not NULL, set to the number of leading bytes of the block that
+ *   may not be zero.
+ *
+ * return: The header of the block, marked ALLOCATED, or NULL if the OS is
+ *   out of memory.
+ */
+
+static header *allocate_block(arena *a, size_t requested_size,
+                              size_t *dirty) {
+
+#if QUICK_LIST_CLASSES > 0
+  if (requested_size <= QUICK_LIST_MAX_SIZE) {
+    header *quick = quick_malloc(a, requested_size);
+    if (quick != NULL) {
+      if (dirty != NULL) {
+        *dirty = usable_size(quick);
+      }
+      return quick;
+    }
+  }
+#endif
+
+  /* Size the OS request so the new block is accepted by find_header() */
+
+  size_t grow_size = search_size(requested_size);
+
+  size_t needed_size = grow_size + ALLOC_HEADER_SIZE;
+  needed_size = roundup(needed_size, MIN_ALLOCATION);
+
+  /* Ensures that the amount of memory being allocated has enough room
+   * for two fenceposts and a header */
+
+  needed_size = grow_size + 3 * ALLOC_HEADER_SIZE > ARENA_SIZE ?
+    grow_size + 3 * ALLOC_HEADER_SIZE : needed_size;
+
+  /* Look for a header with the proper contraints */
+
+  header* found_header = find_header(a, requested_size);
+
+#if REMOTE_FREE
+
+  /* Take back the blocks other threads freed */
+
+  if ((found_header == NULL) && drain_remote(a)) {
+    found_header = find_header(a, requested_size);
+  }
+#endif
+
+#if QUICK_LIST_CLASSES > 0
+
+  /* Coalesce the quick blocks before asking the OS for more */
+
+  if ((found_header == NULL) && consolidate_quick(a)) {
+    found_header = find_header(a, requested_size);
+  }
+#endif
+
+  if (!found_header) {
+    if (get_more_mem(a, needed_size) == NULL) {
+      return NULL;
+    }
+
+    found_header = find_header(a, requested_size);
+  }
+
+  split_header(a, found_header, requested_size);
+
+  /* Only the free list pointers of a block in the clean space were ever
+   * written. The block's end becomes the start of the clean space. */
+
+  char *data = (char *) &found_header->data;
+  if (dirty != NULL) {
+    *dirty = data >= a->clean ? MIN_BLOCK_SIZE :
+      (size_t) (a->clean - data);
+    if (*dirty < MIN_BLOCK_SIZE) {
+      *dirty = MIN_BLOCK_SIZE;
+    }
+  }
+
+  char *end = (char *) right_neighbor(found_header);
+  if (end > a->clean) {
+    a->clean = end;
+  }
+
+  /* Change the state of the found header to ALOOCATED. A compact header's
+   * data ends in the right neighbor's left_size, which is zeroed to keep
+   * the dirty size. */
+
+  found_header->size = found_header->size | (state) ALLOCATED;
+  header *right = right_neighbor(found_header);
+  set_left_used(right, TRUE_SIZE(found_header));
+#if COMPACT_HEADER
+  right->left_size = 0;
+#endif
+  return found_header;
+} /* allocate_block() */
+
+/*
+ * Returns an allocated block to its arena's free lists, coalescing it with
+ * any unallocated neighbors. The arena's mutex must be held.
+ */
+
+static void free_block(arena *a, header *head) {
+  header *left = free_left_neighbor(head);
+  header *right = right_neighbor(head);
+
+  if (isUnallocated(left) && isUnallocated(right)) {
+
+    /* Coalesce with left and right neighbors. The left neighbor keeps its
+     * place in the free list and the right one is unlinked. */
+
+    size_t old_list = list_index(TRUE_SIZE(left));
+    ARENA_STAT(a, coalesces, 2);
+    LATENCY_EVENT(LATENCY_COALESCE_BOTH);
+
+    if (right == a->next_allocate) {
+      a->next_allocate = left;
+    }
+
+    remove_free_block(a, right, list_index(TRUE_SIZE(right)));
+
+    resize_free_block(a, left, TRUE_SIZE(left) + TRUE_SIZE(head) +
+                      TRUE_SIZE(right) + ALLOC_HEADER_SIZE * 2);
+    clear_header(a, right, sizeof(header));
+    set_left_free(right_neighbor(left), TRUE_SIZE(left));
+    refile_free_block(a, left, old_list);
+  }
+  else if (isUnallocated(left)) {
+
+    /* Coalesce with just the left neighbor  */
+
+    size_t old_list = list_index(TRUE_SIZE(left));
+    ARENA_STAT(a, coalesces, 1);
+
+    resize_free_block(a, left,
+                      TRUE_SIZE(left) + TRUE_SIZE(head) + ALLOC_HEADER_SIZE);
+    set_left_free(right, TRUE_SIZE(left));
+    refile_free_block(a, left, old_list);
+  }
+  else if (isUnallocated(right)) {
+
+    /* Coalesce with the right neighbor, taking over its free list spot  */
+
+    size_t old_list = list_index(TRUE_SIZE(right));
+    ARENA_STAT(a, coalesces, 1);
+
+    SET_SIZE(head, TRUE_SIZE(head) + ALLOC_HEADER_SIZE + TRUE_SIZE(right));
+    set_left_free(right_neighbor(head), TRUE_SIZE(head));
+
+    if (list_index(TRUE_SIZE(head)) == old_list) {
+      replace_free_block(a, right, head);
+    }
+    else {
+      if (right == a->next_allocate) {
+        a->next_allocate = head;
+      }
+
+      remove_free_block(a, right, old_list);
+      insert_free_block(a, head);
+    }
+    clear_header(a, right, sizeof(header));
+  }
+  else {
+
+    /* Neither neighbor is unallocated, so just add to free list */
+
+    SET_SIZE(head, TRUE_SIZE(head));
+    set_left_free(right, TRUE_SIZE(head));
+    insert_free_block(a, head);
+  }
+
+  /* Give memory back once the free space at the top of the heap passes
+   * the trim threshold, keeping the top pad */
+
+  if ((TRIM_THRESHOLD > 0) && (a->last_fence_post != NULL)) {
+    header *top = free_left_neighbor(a->last_fence_post);
+    if ((top != NULL) && (TRUE_SIZE(top) >= trim_threshold(a))) {
+      trim_arena(a, GROWTH(top_pad));
+    }
+  }
+} /* free_block() */
+
+#if QUICK_LIST_CLASSES > 0
+
+/*
+ * Merges an arena's quick blocks into its free lists, coalescing each with
+ * its unallocated neighbors. The arena's mutex must be held.
+ *
+ * return: true if there were any quick blocks.
+ */
+
+static bool consolidate_quick(arena *a) {
+  if (a->quick_blocks == 0) {
+    return false;
+  }
+
+  ARENA_STAT(a, consolidations, 1);
+  STAT_SUB(cached_blocks, a->quick_blocks);
+  STAT_SUB(cached_bytes, a->quick_bytes);
+  a->quick_blocks = 0;
+  a->quick_bytes = 0;
+
+  for (size_t i = 0; i < QUICK_LIST_CLASSES; i++) {
+    while (a->quick[i] != NULL) {
+      header *head = a->quick[i];
+      a->quick[i] = head->next;
+      set_state(head, (state) ALLOCATED);
+      free_block(a, head);
+    }
+  }
+  return true;
+} /* consolidate_quick() */
+
+#endif
+
+/*
+ * Frees a block the user gave back. Small blocks go on a quick list, the
+ * rest are coalesced by free_block(). The arena's mutex must be held.
+ *
+ * size: The size the block is filed by, no larger than its true size.
+ */
+
+static void release_block(arena *a, header *head, size_t size) {
+#if QUICK_LIST_CLASSES > 0
+  if (size <= QUICK_LIST_MAX_SIZE) {
+    size_t class = quick_class(size);
+    set_state(head, (state) QUICK);
+    head->next = a->quick[class];
+    a->quick[class] = head;
+    a->quick_blocks++;
+    a->quick_bytes += TRUE_SIZE(head);
+    STAT_ADD(cached_blocks, 1);
+    STAT_ADD(cached_bytes, TRUE_SIZE(head));
+
+    if (a->quick_bytes > QUICK_LIST_MAX_BYTES) {
+      consolidate_quick(a);
+    }
+    return;
+  }
+#else
+  (void) size;
+#endif
+
+  free_block(a, head);
+} /* release_block() */
+
+#if REMOTE_FREE
+
+/*
+ * Pushes a block on its arena's remote free list without taking the
+ * arena's mutex. Any number of threads may push at once. The header is
+ * left as it is, since the arena's mutex holder may be reading it as a
+ * neighbor, so the block stays ALLOCATED until it is drained.
+ */
+
+static void remote_free(arena *a, header *head) {
+  STAT_ADD(cached_blocks, 1);
+  STAT_ADD(cached_bytes, TRUE_SIZE(head));
+#if MALLOC_STATS
+  __atomic_fetch_add(&a->stats.remote_frees, 1, __ATOMIC_RELAXED);
+#endif
+
+  header *first = __atomic_load_n(&a->remote, __ATOMIC_RELAXED);
+  do {
+    head->next = first;
+  } while (!__atomic_compare_exchange_n(&a->remote, &first, head, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+} /* remote_free() */
+
+/*
+ * Takes an arena's whole remote free list at once and frees its blocks.
+ * Blocks pushed meanwhile wait for the next drain. The arena's mutex must
+ * be held.
+ *
+ * return: true if the list had any blocks.
+ */
+
+static bool drain_remote(arena *a) {
+  if (__atomic_load_n(&a->remote, __ATOMIC_RELAXED) == NULL) {
+    return false;
+  }
+
+  header *head = __atomic_exchange_n(&a->remote, NULL, __ATOMIC_ACQUIRE);
+  ARENA_STAT(a, remote_drains, 1);
+
+  while (head != NULL) {
+    header *next = head->next;
+    STAT_SUB(cached_blocks, 1);
+    STAT_SUB(cached_bytes, TRUE_SIZE(head));
+    release_block(a, head, TRUE_SIZE(head));
+    head = next;
+  }
+  return true;
+} /* drain_remote() */
+
+#endif
+
+/*
+ * Locks an arena's mutex. If it is busy, the thread spins on it for a
+ * while, backing off exponentially, since the critical sections are
+ * usually over sooner than a sleep in the kernel would start. Only then
+ * does it block. Counts the acquisition and any time spent waiting.
+ */
+
+static void acquire_arena(arena *a) {
+  if (pthread_mutex_trylock(&a->mutex) == 0) {
+    ARENA_STAT(a, lock_acquires, 1);
+    return;
+  }
+
+  LATENCY_EVENT(LATENCY_LOCK_WAIT);
+#if MALLOC_STATS
+  uint64_t start = read_cycles();
+#endif
+
+  bool spun = false;
+  unsigned int pauses = 1;
+  for (size_t i = 0; (i < g_lock_spins) && !spun; i++) {
+    for (unsigned int j = 0; j < pauses; j++) {
+      cpu_relax();
+    }
+    if (pauses < LOCK_BACKOFF_MAX) {
+      pauses *= 2;
+    }
+    spun = pthread_mutex_trylock(&a->mutex) == 0;
+  }
+
+  if (!spun) {
+    pthread_mutex_lock(&a->mutex);
+  }
+
+#if MALLOC_STATS
+  a->stats.lock_acquires++;
+  a->stats.lock_waits++;
+  a->stats.lock_spins += spun;
+  a->stats.lock_wait_cycles += read_cycles() - start;
+#endif
+} /* acquire_arena() */
+
+/*
+ * Locks and returns the arena the calling thread should allocate from.
+ *
+ * A thread is assigned an arena round robin on its first call. If that
+ * arena's lock is busy, the thread moves to the first other arena whose lock
+ * is free, and only blocks if all of them are busy. Blocks other threads
+ * freed to the arena in the meantime are taken back before it is returned.
+ */
+
+static arena *lock_arena(void) {
+  arena *a = t_arena;
+  if (a == NULL) {
+    size_t index = __atomic_fetch_add(&g_arena_counter, 1, __ATOMIC_RELAXED);
+    a = &g_arenas[index % NUM_ARENAS];
+    t_arena = a;
+  }
+
+  if (pthread_mutex_trylock(&a->mutex) == 0) {
+    ARENA_STAT(a, lock_acquires, 1);
+  }
+  else {
+    arena *found = NULL;
+    for (size_t i = 1; i < NUM_ARENAS; i++) {
+      arena *other = &g_arenas[(a - g_arenas + i) % NUM_ARENAS];
+      if (pthread_mutex_trylock(&other->mutex) == 0) {
+        ARENA_STAT(other, lock_acquires, 1);
+        found = other;
+        break;
+      }
+    }
+
+    if (found != NULL) {
+      a = found;
+      t_arena = a;
+    }
+    else {
+      acquire_arena(a);
+    }
+  }
+
+#if REMOTE_FREE
+  drain_remote(a);
+#endif
+  return a;
+} /* lock_arena() */
+
+/*
+ * Returns the arena owning a block: the arena whose mmap() region contains
+ * it, or arena 0 if there is none.
+ */
+
+static arena *block_arena(header *head) {
+#if NUM_ARENAS > 1
+  char *heap = (char *) ((uintptr_t) head &
+                         ~((uintptr_t) ARENA_HEAP_SIZE - 1));
+
+  for (size_t i = 1; i < NUM_ARENAS; i++) {
+    if (__atomic_load_n(&g_arenas[i].heap_start, __ATOMIC_ACQUIRE) == heap) {
+      return &g_arenas[i];
+    }
+  }
+#else
+  (void) head;
+#endif
+  return &g_arenas[0];
+} /* block_arena() */
+
+#if THREAD_CACHE_SIZE > 0
+
+/*
+ * Returns the cache class a free block of the given size is filed under.
+ */
+
+static inline size_t cache_class(size_t size) {
+  return (size - MIN_BLOCK_SIZE) / MIN_ALLOCATION;
+} /* cache_class() */
+
+/*
+ * Returns the blocks cached in a class to the heap. The lock of each
+ * block's arena is held across consecutive blocks from the same arena.
+ *
+ * count: The number of blocks to return, at most the number cached.
+ */
+
+static void cache_flush(size_t class, size_t count) {
+  arena *locked = NULL;
+
+  for (size_t i = 0; i < count; i++) {
+    header *head = t_cache.blocks[class];
+    t_cache.blocks[class] = head->next;
+    t_cache.counts[class]--;
+    STAT_SUB(cached_blocks, 1);
+    STAT_SUB(cached_bytes, TRUE_SIZE(head));
+
+    arena *a = block_arena(head);
+    if (a != locked) {
+      if (locked != NULL) {
+        pthread_mutex_unlock(&locked->mutex);
+      }
+      acquire_arena(a);
+      locked = a;
+    }
+
+    set_state(head, (state) ALLOCATED);
+    free_block(a, head);
+  }
+
+  if (locked != NULL) {
+    pthread_mutex_unlock(&locked->mutex);
+  }
+} /* cache_flush() */
+
+/*
+ * Destructor of g_cache_key. Returns every cached block to the heap so that
+ * memory is not stranded when a thread exits.
+ */
+
+static void cache_release(void *unused) {
+  (void) unused;
+
+  for (size_t i = 0; i < THREAD_CACHE_CLASSES; i++) {
+    cache_flush(i, t_cache.counts[i]);
+  }
+
+  /* Another destructor may still cache blocks, which registers again */
+
+  t_cache.registered = false;
+} /* cache_release() */
+
+/*
+ * Makes sure the destructor runs for this thread, whether it first uses its
+ * cache to allocate or to free.
+ */
+
+static inline void cache_register(void) {
+  if (__builtin_expect(!t_cache.registered, 0)) {
+    t_cache.registered = true;
+    pthread_setspecific(g_cache_key, &t_cache);
+  }
+} /* cache_register() */
+
+/*
+ * Fills an empty class of the thread cache with up to THREAD_CACHE_BATCH
+ * blocks from an arena. The arena's mutex must be held.
+ */
+
+static void cache_refill(arena *a, size_t class) {
+  for (size_t i = 0; i < THREAD_CACHE_BATCH; i++) {
+    header *head = allocate_block(a,
+      block_size(MIN_BLOCK_SIZE + class * MIN_ALLOCATION), NULL);
+    if (head == NULL) {
+      break;
+    }
+
+    set_state(head, (state) CACHED);
+    head->next = t_cache.blocks[class];
+    t_cache.blocks[class] = head;
+    t_cache.counts[class]++;
+    STAT_ADD(cached_blocks, 1);
+    STAT_ADD(cached_bytes, TRUE_SIZE(head));
+  }
+} /* cache_refill() */
+
+/*
+ * Allocates a small block from the thread cache. If the cache is empty, it
+ * is refilled with THREAD_CACHE_BATCH blocks under a single arena lock hold.
+ *
+ * size: The block size, as returned by block_size().
+ */
+
+static void *cache_malloc(size_t size) {
+
+  /* Take the first class whose blocks are all large enough */
+
+  size_t class = (size - MIN_BLOCK_SIZE + MIN_ALLOCATION - 1) /
+    MIN_ALLOCATION;
+
+  if (t_cache.counts[class] == 0) {
+    arena *a = lock_arena();
+    cache_refill(a, class);
+    pthread_mutex_unlock(&a->mutex);
+
+    /* Fall back to arena 0 if another arena's region is exhausted */
+
+    if ((t_cache.counts[class] == 0) && (a != &g_arenas[0])) {
+      a = &g_arenas[0];
+      acquire_arena(a);
+      cache_refill(a, class);
+      pthread_mutex_unlock(&a->mutex);
+    }
+
+    if (t_cache.counts[class] == 0) {
+      return NULL;
+    }
+
+    cache_register();
+  }
+
+  header *head = t_cache.blocks[class];
+  t_cache.blocks[class] = head->next;
+  t_cache.counts[class]--;
+  STAT_SUB(cached_blocks, 1);
+  STAT_SUB(cached_bytes, TRUE_SIZE(head));
+
+  set_state(head, (state) ALLOCATED);
+  return &head->data;
+} /* cache_malloc() */
+
+/*
+ * Puts a small block in the thread cache. Once a class holds more than
+ * THREAD_CACHE_SIZE blocks, THREAD_CACHE_BATCH of them are returned to the
+ * heap.
+ *
+ * class: A class no larger than that of the block's size.
+ */
+
+static void cache_free(header *head, size_t class) {
+  cache_register();
+
+  set_state(head, (state) CACHED);
+  head->next = t_cache.blocks[class];
+  t_cache.blocks[class] = head;
+  t_cache.counts[class]++;
+  STAT_ADD(cached_blocks, 1);
+  STAT_ADD(cached_bytes, TRUE_SIZE(head));
+
+  if (t_cache.counts[class] > THREAD_CACHE_SIZE) {
+    cache_flush(class, THREAD_CACHE_BATCH);
+  }
+} /* cache_free() */
+
+#endif
+
+#if SLAB_MAX_SIZE > 0
+
+/*
+ * Returns the slab holding an object, or NULL if ptr is not in the slab
+ * region.
+ */
+
+static inline slab *object_slab(void *ptr) {
+  char *heap = __atomic_load_n(&g_slab_heap, __ATOMIC_ACQUIRE);
+  if ((heap == NULL) || ((uintptr_t) ptr - (uintptr_t) heap >=
+                         SLAB_HEAP_SIZE)) {
+    return NULL;
+  }
+  return (slab *) ((uintptr_t) ptr & ~((uintptr_t) SLAB_SIZE - 1));
+} /* object_slab() */
+
+/*
+ * Takes an empty slab, or carves a new one from the slab region, and sets
+ * it up with every object free.
+ *
+ * return: The slab, or NULL if the region is full.
+ */
+
+static slab *new_slab(size_t object_size) {
+  pthread_mutex_lock(&g_slab_mutex);
+
+  slab *s = g_empty_slabs;
+  if (s != NULL) {
+    g_empty_slabs = s->next;
+  }
+  else {
+    if (g_slab_heap == NULL) {
+      char *heap = map_aligned(SLAB_HEAP_SIZE);
+      if (heap != NULL) {
+        g_slab_top = heap;
+        __atomic_store_n(&g_slab_heap, heap, __ATOMIC_RELEASE);
+      }
+    }
+
+    if ((g_slab_heap != NULL) &&
+        (g_slab_top < g_slab_heap + SLAB_HEAP_SIZE)) {
+      s = (slab *) g_slab_top;
+      g_slab_top += SLAB_SIZE;
+    }
+  }
+
+  pthread_mutex_unlock(&g_slab_mutex);
+
+  if (s == NULL) {
+    return NULL;
+  }
+
+  s->next = NULL;
+  s->prev = NULL;
+  s->object_size = object_size;
+  s->capacity = (SLAB_SIZE - SLAB_HEADER_SIZE) / object_size;
+  s->free_count = s->capacity;
+
+  for (size_t i = 0; i < SLAB_BITMAP_WORDS; i++) {
+    size_t first = i * BITMAP_BITS;
+    if (first + BITMAP_BITS <= s->capacity) {
+      s->bitmap[i] = ~(size_t) 0;
+    }
+    else if (first < s->capacity) {
+      s->bitmap[i] = ((size_t) 1 << (s->capacity - first)) - 1;
+    }
+    else {
+      s->bitmap[i] = 0;
+    }
+  }
+  return s;
+} /* new_slab() */
+
+/*
+ * Allocates an object from the first slab of its class with a free object.
+ *
+ * return: The object, or NULL if the slab region is full.
+ */
+
+static void *slab_malloc(size_t size) {
+  size_t class = (size - 1) / MIN_ALLOCATION;
+  slab_class *c = &g_slab_classes[class];
+
+  pthread_mutex_lock(&c->mutex);
+
+  slab *s = c->partial;
+  if (s == NULL) {
+    s = new_slab((class + 1) * MIN_ALLOCATION);
+    if (s == NULL) {
+      pthread_mutex_unlock(&c->mutex);
+      return NULL;
+    }
+    c->partial = s;
+  }
+
+  size_t word = 0;
+  while (s->bitmap[word] == 0) {
+    word++;
+  }
+  size_t bit = __builtin_ctzl(s->bitmap[word]);
+  s->bitmap[word] &= ~((size_t) 1 << bit);
+
+  /* A full slab leaves the list until an object is freed */
+
+  if (--s->free_count == 0) {
+    c->partial = s->next;
+    if (s->next != NULL) {
+      s->next->prev = NULL;
+    }
+    s->next = NULL;
+  }
+
+  pthread_mutex_unlock(&c->mutex);
+
+  return ((char *) s) + SLAB_HEADER_SIZE +
+    (word * BITMAP_BITS + bit) * s->object_size;
+} /* slab_malloc() */
+
+/*
+ * Returns an object to its slab. A slab that becomes empty is given back to
+ * the slab region, unless it is the only one left in its class.
+ */
+
+static void slab_free(slab *s, void *ptr) {
+  size_t offset = ((char *) ptr) - (((char *) s) + SLAB_HEADER_SIZE);
+  size_t index = offset / s->object_size;
+  size_t class = s->object_size / MIN_ALLOCATION - 1;
+  slab_class *c = &g_slab_classes[class];
+
+  pthread_mutex_lock(&c->mutex);
+
+  /* Ensures that the object is allocated to the user */
+
+  size_t mask = (size_t) 1 << (index % BITMAP_BITS);
+  if ((offset % s->object_size != 0) || (index >= s->capacity) ||
+      (s->bitmap[index / BITMAP_BITS] & mask)) {
+    assert(false);
+    exit(1);
+  }
+
+  s->bitmap[index / BITMAP_BITS] |= mask;
+  s->free_count++;
+
+  if (s->free_count == 1) {
+    s->next = c->partial;
+    s->prev = NULL;
+    if (c->partial != NULL) {
+      c->partial->prev = s;
+    }
+    c->partial = s;
+  }
+  else if ((s->free_count == s->capacity) &&
+           ((s->prev != NULL) || (s->next != NULL))) {
+    if (s->prev != NULL) {
+      s->prev->next = s->next;
+    }
+    else {
+      c->partial = s->next;
+    }
+    if (s->next != NULL) {
+      s->next->prev = s->prev;
+    }
+
+    pthread_mutex_lock(&g_slab_mutex);
+    s->next = g_empty_slabs;
+    g_empty_slabs = s;
+    pthread_mutex_unlock(&g_slab_mutex);
+  }
+
+  pthread_mutex_unlock(&c->mutex);
+} /* slab_free() */
+
+#endif
+
+/*
+ * Allocates a block in an anonymous mapping of its own.
+ *
+ * size: The block size, as returned by block_size().
+ * alignment: The alignment of the block's data, a power of two. The header
+ *   stays in the first page of the mapping.
+ *
+ * return: The header of the block, marked MMAPPED, or NULL if the mapping
+ *   failed.
+ */
+
+static header *mmap_block(size_t size, size_t alignment) {
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+  /* A mapped block has no right neighbor to lend it a left_size */
+
+  size += LEFT_SIZE_OVERLAP;
+
+  /* The data starts at the first multiple of alignment past the header,
+   * up to alignment - 1 bytes further on unless the header is a multiple
+   * of it (a compact header is smaller than a larger MIN_ALLOCATION) */
+
+  size_t slack = ALLOC_HEADER_SIZE % alignment == 0 ? 0 : alignment - 1;
+  size_t length = roundup(size + ALLOC_HEADER_SIZE + slack, page_size);
+
+  LATENCY_EVENT(LATENCY_MMAP);
+  char *mem = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  /* Unmap the whole pages around the aligned block */
+
+  char *data = (char *) roundup((uintptr_t) mem + ALLOC_HEADER_SIZE,
+                                alignment);
+  char *start = (char *) ((uintptr_t) (data - ALLOC_HEADER_SIZE) &
+                          ~((uintptr_t) page_size - 1));
+  char *end = (char *) roundup((uintptr_t) data + size, page_size);
+  assert(end <= mem + length);
+  if (start != mem) {
+    munmap(mem, start - mem);
+  }
+  if (end != mem + length) {
+    munmap(end, mem + length - end);
+  }
+
+  /* Hand the caller the rest of the mapping */
+
+  header *head = (header *) (data - ALLOC_HEADER_SIZE);
+  head->size = (end - data) | (state) MMAPPED;
+  head->left_size = end - start;
+
+  STAT_ADD(mapped_blocks, 1);
+  STAT_ADD(mapped_bytes, head->left_size);
+  return head;
+} /* mmap_block() */
+
+/*
+ * Returns the start of an MMAPPED block's mapping.
+ */
+
+static inline char *mapping_start(header *head) {
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  return (char *) ((uintptr_t) head & ~((uintptr_t) page_size - 1));
+} /* mapping_start() */
+
+/*
+ * Unmaps an MMAPPED block.
+ */
+
+static void unmap_block(header *head) {
+  LATENCY_EVENT(LATENCY_MMAP);
+  STAT_SUB(mapped_blocks, 1);
+  STAT_SUB(mapped_bytes, head->left_size);
+  munmap(mapping_start(head), head->left_size);
+} /* unmap_block() */
+
+/*
+ * Allocates a block for my_malloc() and my_calloc().
+ *
+ * dirty: Set to the number of leading bytes of the block that may not be
+ *   zero. The rest has not been written since it came from the OS.
+ */
+
+static void *allocate(size_t requested_size, size_t *dirty) {
+  ensure_init();
+
+  /* Make sure that NULL is returned when allocating no mem. */
+
+  if (requested_size == 0) {
+    return NULL;
+  }
+
+  /* Requests this large can never be satisfied, and would overflow the
+   * rounding below */
+
+  if (requested_size > MAX_REQUEST) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+#if SLAB_MAX_SIZE > 0
+  if (requested_size <= SLAB_MAX_SIZE) {
+    void *object = slab_malloc(requested_size);
+    if (object != NULL) {
+      *dirty = requested_size;
+      return object;
+    }
+  }
+#endif
+
+  requested_size = block_size(requested_size);
+
+  if ((MMAP_THRESHOLD > 0) && (requested_size >= MMAP_THRESHOLD)) {
+    header *mapped = mmap_block(requested_size, MIN_ALLOCATION);
+    *dirty = 0;
+    return mapped == NULL ? NULL : &mapped->data;
+  }
+
+#if THREAD_CACHE_SIZE > 0
+  if (requested_size <= THREAD_CACHE_MAX_SIZE) {
+    *dirty = requested_size + LEFT_SIZE_OVERLAP;
+    return cache_malloc(requested_size);
+  }
+#endif
+
+  arena *a = lock_arena();
+  header *found_header = allocate_block(a, requested_size, dirty);
+  pthread_mutex_unlock(&a->mutex);
+
+  /* Fall back to arena 0 if another arena's region is exhausted */
+
+  if ((found_header == NULL) && (a != &g_arenas[0])) {
+    a = &g_arenas[0];
+    acquire_arena(a);
+    found_header = allocate_block(a, requested_size, dirty);
+    pthread_mutex_unlock(&a->mutex);
+  }
+
+  if (found_header == NULL) {
+    return NULL;
+  }
+  return &found_header->data;
+} /* allocate() */
+
+/*
+ * This is my version of malloc().
+ *
+ * Allocates the requested memory to the user.
+ */
+
+void *my_malloc(size_t requested_size) {
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+#endif
+
+  size_t dirty = 0;
+  void *mem = allocate(requested_size, &dirty);
+  if (mem != NULL) {
+    STAT_ADD(in_use, my_malloc_usable_size(mem));
+  }
+
+#if MALLOC_LATENCY
+  latency_record(LATENCY_MALLOC, start);
+#endif
+  TRACE(TRACE_MALLOC, mem, NULL, requested_size);
+  return mem;
+} /* my_malloc() */
+
+/*
+ * Returns a block to the free lists, coalescing it with any unallocated
+ * neighbors, or to a thread cache or quick list.
+ */
+
+static void free_pointer(void *p) {
+  STAT_SUB(in_use, my_malloc_usable_size(p));
+
+#if SLAB_MAX_SIZE > 0
+  slab *s = object_slab(p);
+  if (s != NULL) {
+    slab_free(s, p);
+    return;
+  }
+#endif
+
+  header *head = (header *) (((char *) p) - ALLOC_HEADER_SIZE);
+
+  /* Blocks with a mapping of their own go straight back to the OS */
+
+  if (STATE(head) == (state) MMAPPED) {
+    unmap_block(head);
+    return;
+  }
+
+  /* Ensures that the block is allocated to the user (not unallocated or
+   * already sitting in a thread cache) */
+
+  if (STATE(head) != (state) ALLOCATED) {
+    assert(false);
+    exit(1);
+  }
+
+#if THREAD_CACHE_SIZE > 0
+  if (TRUE_SIZE(head) <= THREAD_CACHE_MAX_SIZE) {
+    cache_free(head, cache_class(TRUE_SIZE(head)));
+    return;
+  }
+#endif
+
+  arena *a = block_arena(head);
+
+#if REMOTE_FREE
+  if ((t_arena != NULL) && (a != t_arena)) {
+    remote_free(a, head);
+    return;
+  }
+#endif
+
+  acquire_arena(a);
+  release_block(a, head, TRUE_SIZE(head));
+  pthread_mutex_unlock(&a->mutex);
+} /* free_pointer() */
+
+/*
+ * This is my version of free().
+ */
+
+void my_free(void *p) {
+  if (p == NULL) {
+    return;
+  }
+
+  /* Traced before the block can be reused, so that the trace's order is
+   * one the heap could have seen */
+
+  TRACE(TRACE_FREE, p, NULL, 0);
+
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+  free_pointer(p);
+  latency_record(LATENCY_FREE, start);
+#else
+  free_pointer(p);
+#endif
+} /* my_free() */
+
+/*
+ * Returns the number of bytes the caller may use in an allocated block,
+ * which can be more than were requested.
+ */
+
+size_t my_malloc_usable_size(void *p) {
+  if (p == NULL) {
+    return 0;
+  }
+
+#if SLAB_MAX_SIZE > 0
+  slab *s = object_slab(p);
+  if (s != NULL) {
+    return s->object_size;
+  }
+#endif
+
+  header *head = (header *) (((char *) p) - ALLOC_HEADER_SIZE);
+  return usable_size(head);
+} /* my_malloc_usable_size() */
+
+/*
+ * Returns a block whose size the caller knows to a thread cache or quick
+ * list, picked by that size, or to the free lists.
+ *
+ * size: As passed to my_free_sized(), at most MAX_REQUEST.
+ */
+
+static void free_sized_pointer(void *p, size_t size) {
+
+  /* The usable size of a slab object can pass SLAB_MAX_SIZE, so the slab
+   * region is checked whatever the size */
+
+#if SLAB_MAX_SIZE > 0
+  slab *s = object_slab(p);
+  if (s != NULL) {
+    assert(size <= s->object_size);
+    STAT_SUB(in_use, s->object_size);
+    slab_free(s, p);
+    return;
+  }
+#endif
+
+  header *head = (header *) (((char *) p) - ALLOC_HEADER_SIZE);
+  size_t block = block_size(size);
+
+#if FREE_SIZED_CHECK
+  if (((STATE(head) != (state) ALLOCATED) &&
+       (STATE(head) != (state) MMAPPED)) || (block > TRUE_SIZE(head))) {
+    assert(false);
+    exit(1);
+  }
+#endif
+
+  /* The caller's size picks the cache or quick list class. Only the state
+   * is read from the header, since a mapped block cannot be told from its
+   * size, and the stats count the block's true size */
+
+  STAT_SUB(in_use, usable_size(head));
+
+  if (STATE(head) == (state) MMAPPED) {
+    unmap_block(head);
+    return;
+  }
+
+#if THREAD_CACHE_SIZE > 0
+  if (block <= THREAD_CACHE_MAX_SIZE) {
+    cache_free(head, cache_class(block));
+    return;
+  }
+#endif
+
+  arena *a = block_arena(head);
+
+#if REMOTE_FREE
+  if ((t_arena != NULL) && (a != t_arena)) {
+    remote_free(a, head);
+    return;
+  }
+#endif
+
+  acquire_arena(a);
+  release_block(a, head, block);
+  pthread_mutex_unlock(&a->mutex);
+} /* free_sized_pointer() */
+
+/*
+ * Frees a block whose requested size the caller knows. The size picks the
+ * thread cache or quick list class directly instead of the header. The
+ * header is only read to tell mapped blocks apart, and is checked against
+ * the size when FREE_SIZED_CHECK is set.
+ *
+ * size: The size passed to my_malloc() or its variants, or the block's
+ *   usable size.
+ */
+
+void my_free_sized(void *p, size_t size) {
+  if ((p == NULL) || (size == 0) || (size > MAX_REQUEST)) {
+    my_free(p);
+    return;
+  }
+
+  TRACE(TRACE_FREE, p, NULL, 0);
+
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+  free_sized_pointer(p, size);
+  latency_record(LATENCY_FREE, start);
+#else
+  free_sized_pointer(p, size);
+#endif
+} /* my_free_sized() */
+
+/*
+ * Gives the free memory at the top of every arena back to the OS, keeping
+ * pad bytes free at the top of each. Remote and quick blocks are coalesced
+ * first.
+ *
+ * return: 1 if any memory was released, 0 otherwise.
+ */
+
+int my_malloc_trim(size_t pad) {
+  size_t released = 0;
+
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    acquire_arena(&g_arenas[i]);
+#if REMOTE_FREE
+    drain_remote(&g_arenas[i]);
+#endif
+#if QUICK_LIST_CLASSES > 0
+    consolidate_quick(&g_arenas[i]);
+#endif
+    released += trim_arena(&g_arenas[i], pad);
+    pthread_mutex_unlock(&g_arenas[i].mutex);
+  }
+  return released > 0;
+} /* my_malloc_trim() */
+
+/*
+ * Sets an allocator parameter at runtime:
+ *
+ *   M_FIT_ALGORITHM   the fit algorithm of every arena, 1-4 or
+ *                     FIT_ADAPTIVE. TLSF builds cannot change algorithm.
+ *   M_GROWTH_PERCENT  GROWTH_PERCENT, 0 or at most 100 to turn geometric
+ *                     growth off
+ *   M_GROWTH_MAX      GROWTH_MAX, at least ARENA_SIZE
+ *   M_GROWTH_MIN      GROWTH_MIN, at least ARENA_SIZE
+ *   M_GROWTH_TOP_PAD  GROWTH_TOP_PAD
+ *
+ * return: 1 if the parameter was set, 0 otherwise.
+ */
+
+int my_mallopt(int param, int value) {
+  ensure_init();
+
+  size_t *growth = NULL;
+  size_t least = 0;
+  switch (param) {
+    case M_GROWTH_PERCENT:
+      growth = &g_growth.percent;
+      break;
+    case M_GROWTH_MAX:
+      growth = &g_growth.max;
+      least = ARENA_SIZE;
+      break;
+    case M_GROWTH_MIN:
+      growth = &g_growth.min;
+      least = ARENA_SIZE;
+      break;
+    case M_GROWTH_TOP_PAD:
+      growth = &g_growth.top_pad;
+      break;
+  }
+  if (growth != NULL) {
+    if ((value < 0) || ((size_t) value < least)) {
+      return 0;
+    }
+    __atomic_store_n(growth, (size_t) value, __ATOMIC_RELAXED);
+    return 1;
+  }
+
+#if FIT_ALGORITHM != 5
+  if ((param == M_FIT_ALGORITHM) && (value >= 0) &&
+      (value < (int) FIT_SEARCHES)) {
+    for (size_t i = 0; i < NUM_ARENAS; i++) {
+      acquire_arena(&g_arenas[i]);
+      set_fit(&g_arenas[i], value);
+      pthread_mutex_unlock(&g_arenas[i].mutex);
+    }
+    return 1;
+  }
+#endif
+
+  (void) param;
+  (void) value;
+  return 0;
+} /* my_mallopt() */
+
+/*
+ * Sets size bytes to zero. Large ranges are written with non-temporal
+ * stores that bypass the cache.
+ */
+
+static void zero_memory(void *mem, size_t size) {
+#if defined(__SSE2__)
+  if ((STREAM_ZERO_THRESHOLD > 0) && (size >= STREAM_ZERO_THRESHOLD)) {
+    char *start = (char *) roundup((uintptr_t) mem, sizeof(__m128i));
+    char *end = (char *) (((uintptr_t) mem + size) &
+                          ~((uintptr_t) sizeof(__m128i) - 1));
+    __m128i zero = _mm_setzero_si128();
+
+    memset(mem, 0, start - (char *) mem);
+    for (char *p = start; p < end; p += sizeof(__m128i)) {
+      _mm_stream_si128((__m128i *) p, zero);
+    }
+    memset(end, 0, (char *) mem + size - end);
+
+    /* Order the streaming stores before the block is handed out */
+
+    _mm_sfence();
+    return;
+  }
+#endif
+
+  memset(mem, 0, size);
+} /* zero_memory() */
+
+/*
+ * Allocates an array of nmemb elements of size bytes, set to zero. Only the
+ * part of the block that has been written before is cleared, since memory
+ * fresh from the OS is already zero.
+ */
+
+void *my_calloc(size_t nmemb, size_t size) {
+  if ((size != 0) && (nmemb > SIZE_MAX / size)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+#endif
+
+  size_t total = nmemb * size;
+  size_t dirty = 0;
+  void *mem = allocate(total, &dirty);
+  if (mem != NULL) {
+    zero_memory(mem, dirty < total ? dirty : total);
+    STAT_ADD(in_use, my_malloc_usable_size(mem));
+  }
+
+#if MALLOC_LATENCY
+  latency_record(LATENCY_CALLOC, start);
+#endif
+  if (mem != NULL) {
+    TRACE(TRACE_CALLOC, mem, NULL, total);
+  }
+  return mem;
+} /* my_calloc() */
+
+/*
+ * Shrinks an allocated block to the given size, returning the tail to the
+ * free lists (coalescing it with the right neighbor) if it is large enough
+ * to be a block of its own. The arena's mutex must be held.
+ *
+ * size: The new block size, as returned by block_size().
+ */
+
+static void shrink_block(arena *a, header *head, size_t size) {
+  if (TRUE_SIZE(head) < size + ALLOC_HEADER_SIZE + MIN_BLOCK_SIZE) {
+    return;
+  }
+
+  ARENA_STAT(a, splits, 1);
+
+  header *tail = (header *) (((char *) head) + ALLOC_HEADER_SIZE + size);
+  tail->size = (TRUE_SIZE(head) - size - ALLOC_HEADER_SIZE) |
+    (state) ALLOCATED;
+  set_left_used(tail, size);
+  set_left_used(right_neighbor(tail), TRUE_SIZE(tail));
+
+  SET_SIZE(head, size | STATE(head));
+  free_block(a, tail);
+} /* shrink_block() */
+
+/*
+ * Resizes an allocated heap block without moving it: shrinking splits off
+ * the tail, growing absorbs an unallocated right neighbor.
+ *
+ * size: The new block size, as returned by block_size().
+ *
+ * return: true if the block now holds size bytes, false if it has to move.
+ */
+
+static bool resize_block(header *head, size_t size) {
+  arena *a = block_arena(head);
+  acquire_arena(a);
+
+  if (size > TRUE_SIZE(head)) {
+    header *right = right_neighbor(head);
+    if (!isUnallocated(right) ||
+        (TRUE_SIZE(head) + ALLOC_HEADER_SIZE + TRUE_SIZE(right) < size)) {
+      pthread_mutex_unlock(&a->mutex);
+      return false;
+    }
+
+    /* Absorb the right neighbor */
+
+    ARENA_STAT(a, coalesces, 1);
+
+    if (right == a->next_allocate) {
+      a->next_allocate = FREE_NEXT(a, right);
+    }
+    remove_free_block(a, right, list_index(TRUE_SIZE(right)));
+
+    SET_SIZE(head, (TRUE_SIZE(head) + ALLOC_HEADER_SIZE + TRUE_SIZE(right)) |
+             STATE(head));
+    set_left_used(right_neighbor(head), TRUE_SIZE(head));
+
+    /* The absorbed space now belongs to the caller */
+
+    char *end = (char *) right_neighbor(head);
+    if (end > a->clean) {
+      a->clean = end;
+    }
+  }
+
+  shrink_block(a, head, size);
+  pthread_mutex_unlock(&a->mutex);
+  return true;
+} /* resize_block() */
+
+/*
+ * Reallocates an allocated block to a new size. The block is resized in
+ * place when possible; otherwise the contents are copied to a new block.
+ */
+
+static void *realloc_block(void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return my_malloc(size);
+  }
+
+  if (size == 0) {
+    my_free(ptr);
+    return NULL;
+  }
+
+  if (size > MAX_REQUEST) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+#if SLAB_MAX_SIZE > 0
+
+  /* Objects stay in their slab as long as they fit */
+
+  slab *s = object_slab(ptr);
+  if (s != NULL) {
+    if (size <= s->object_size) {
+      return ptr;
+    }
+
+    void *mem = my_malloc(size);
+    if (mem != NULL) {
+      memcpy(mem, ptr, s->object_size);
+      my_free(ptr);
+    }
+    return mem;
+  }
+#endif
+
+  header *head = (header *) (((char *) ptr) - ALLOC_HEADER_SIZE);
+  size_t new_size = block_size(size);
+
+  if (STATE(head) == (state) MMAPPED) {
+
+    /* Let the kernel move the pages instead of copying them */
+
+    if ((MMAP_THRESHOLD > 0) && (new_size >= MMAP_THRESHOLD)) {
+      size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+      char *start = mapping_start(head);
+      size_t offset = ((char *) head) - start;
+      size_t length = roundup(offset + ALLOC_HEADER_SIZE + new_size +
+                              LEFT_SIZE_OVERLAP, page_size);
+
+      STAT_SUB(in_use, TRUE_SIZE(head));
+      STAT_SUB(mapped_bytes, head->left_size);
+
+      char *moved = mremap(start, head->left_size, length, MREMAP_MAYMOVE);
+      if (moved == MAP_FAILED) {
+        STAT_ADD(in_use, TRUE_SIZE(head));
+        STAT_ADD(mapped_bytes, head->left_size);
+        errno = ENOMEM;
+        return NULL;
+      }
+
+      /* The header keeps its offset within the first page */
+
+      head = (header *) (moved + offset);
+      head->size = (length - offset - ALLOC_HEADER_SIZE) | (state) MMAPPED;
+      head->left_size = length;
+
+      STAT_ADD(in_use, TRUE_SIZE(head));
+      STAT_ADD(mapped_bytes, length);
+      return &head->data;
+    }
+  }
+  else {
+    if (STATE(head) != (state) ALLOCATED) {
+      assert(false);
+      exit(1);
+    }
+
+    STAT_SUB(in_use, usable_size(head));
+    bool resized = resize_block(head, new_size);
+    STAT_ADD(in_use, usable_size(head));
+
+    if (resized) {
+      return ptr;
+    }
+  }
+
+  /* Move the block, copying only what both blocks hold */
+
+  void *mem = my_malloc(size);
+  if (mem == NULL) {
+    return NULL;
+  }
+
+  memcpy(mem, ptr, usable_size(head) < size ? usable_size(head) : size);
+  my_free(ptr);
+  return mem;
+} /* realloc_block() */
+
+/*
+ * This is my version of realloc().
+ */
+
+void *my_realloc(void *ptr, size_t size) {
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+#endif
+
+  /* The my_malloc() and my_free() calls made while moving the block are
+   * part of this call, not calls of their own */
+
+#if MALLOC_TRACE
+  t_trace_depth++;
+  void *mem = realloc_block(ptr, size);
+  t_trace_depth--;
+#else
+  void *mem = realloc_block(ptr, size);
+#endif
+
+#if MALLOC_LATENCY
+  latency_record(LATENCY_REALLOC, start);
+#endif
+  TRACE(TRACE_REALLOC, mem, ptr, size);
+  return mem;
+} /* my_realloc() */
+
+/*
+ * Allocates a block whose data is aligned to alignment, a power of two
+ * larger than MIN_ALLOCATION. A larger block is taken from the arena and
+ * the data placed at the first aligned address that leaves room for a
+ * block in front of it. That leading block and the unused tail are
+ * returned to the free lists. The arena's mutex must be held.
+ *
+ * size: The block size, as returned by block_size().
+ */
+
+static header *allocate_aligned(arena *a, size_t alignment, size_t size) {
+  header *head = allocate_block(a, size + alignment + sizeof(header), NULL);
+  if (head == NULL) {
+    return NULL;
+  }
+
+  uintptr_t data = (uintptr_t) &head->data;
+  if (data % alignment != 0) {
+    uintptr_t aligned = roundup(data + sizeof(header), alignment);
+    header *block = (header *) (aligned - ALLOC_HEADER_SIZE);
+    size_t lead_size = ((char *) block) - ((char *) head) -
+      ALLOC_HEADER_SIZE;
+
+    block->size = (TRUE_SIZE(head) - lead_size - ALLOC_HEADER_SIZE) |
+      (state) ALLOCATED;
+    set_left_used(block, lead_size);
+    set_left_used(right_neighbor(block), TRUE_SIZE(block));
+
+    SET_SIZE(head, lead_size | (state) ALLOCATED);
+    ARENA_STAT(a, splits, 1);
+    free_block(a, head);
+    head = block;
+  }
+
+  shrink_block(a, head, size);
+  return head;
+} /* allocate_aligned() */
+
+/*
+ * Allocates size bytes aligned to alignment, for my_memalign().
+ */
+
+static void *memalign_block(size_t alignment, size_t size) {
+  if ((alignment == 0) || ((alignment & (alignment - 1)) != 0)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  /* Every block is already aligned to MIN_ALLOCATION */
+
+  if (alignment <= MIN_ALLOCATION) {
+    return my_malloc(size);
+  }
+
+  ensure_init();
+
+  if (size == 0) {
+    return NULL;
+  }
+
+  if ((size > MAX_REQUEST / 2) || (alignment > MAX_REQUEST / 2)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  size_t block = block_size(size);
+  header *head = NULL;
+
+  if ((MMAP_THRESHOLD > 0) && (block + alignment >= MMAP_THRESHOLD)) {
+    head = mmap_block(block, alignment);
+  }
+  else {
+    arena *a = lock_arena();
+    head = allocate_aligned(a, alignment, block);
+    pthread_mutex_unlock(&a->mutex);
+
+    /* Fall back to arena 0 if another arena's region is exhausted */
+
+    if ((head == NULL) && (a != &g_arenas[0])) {
+      a = &g_arenas[0];
+      acquire_arena(a);
+      head = allocate_aligned(a, alignment, block);
+      pthread_mutex_unlock(&a->mutex);
+    }
+  }
+
+  void *mem = NULL;
+  if (head != NULL) {
+    STAT_ADD(in_use, usable_size(head));
+    mem = &head->data;
+  }
+  TRACE(TRACE_MEMALIGN, mem, (void *) alignment, size);
+  return mem;
+} /* memalign_block() */
+
+/*
+ * Allocates size bytes aligned to alignment, which must be a power of two.
+ * Returns NULL and sets errno to EINVAL if it is not.
+ */
+
+void *my_memalign(size_t alignment, size_t size) {
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+  void *mem = memalign_block(alignment, size);
+  latency_record(LATENCY_MEMALIGN, start);
+  return mem;
+#else
+  return memalign_block(alignment, size);
+#endif
+} /* my_memalign() */
+
+/*
+ * POSIX version of my_memalign(). The alignment must also be a multiple of
+ * sizeof(void *).
+ *
+ * return: 0 on success, otherwise EINVAL or ENOMEM. errno is left alone.
+ */
+
+int my_posix_memalign(void **memptr, size_t alignment, size_t size) {
+  if ((alignment % sizeof(void *) != 0) ||
+      ((alignment & (alignment - 1)) != 0) || (alignment == 0)) {
+    return EINVAL;
+  }
+
+  int saved_errno = errno;
+  void *mem = my_memalign(alignment, size);
+  if ((mem == NULL) && (size != 0)) {
+    int error = errno;
+    errno = saved_errno;
+    return error;
+  }
+
+  errno = saved_errno;
+  *memptr = mem;
+  return 0;
+} /* my_posix_memalign() */
+
+/*
+ * C11 version of my_memalign().
+ */
+
+void *my_aligned_alloc(size_t alignment, size_t size) {
+  return my_memalign(alignment, size);
+} /* my_aligned_alloc() */
+
+/*
+ * Carves count blocks of the same size out of one free block, taken with a
+ * single search and split. Falls back to taking the blocks one at a time
+ * if no free block or OS request can hold them all. The arena's mutex must
+ * be held.
+ *
+ * size: The block size, as returned by block_size().
+ *
+ * return: The number of blocks stored in out.
+ */
+
+static size_t allocate_batch(arena *a, size_t size, size_t count,
+                             void **out) {
+  if (count <= MAX_REQUEST / (size + ALLOC_HEADER_SIZE)) {
+    size_t total = count * (size + ALLOC_HEADER_SIZE) - ALLOC_HEADER_SIZE;
+    header *head = allocate_block(a, total, NULL);
+
+    if (head != NULL) {
+      header *right = right_neighbor(head);
+      for (size_t i = 0; i < count; i++) {
+        out[i] = &head->data;
+        if (i + 1 < count) {
+          SET_SIZE(head, size | (state) ALLOCATED);
+          header *next = right_neighbor(head);
+          set_left_used(next, size);
+          head = next;
+        }
+      }
+
+      /* The last block keeps whatever allocate_block() did not split off */
+
+      SET_SIZE(head, (((char *) right) - ((char *) head) -
+                      ALLOC_HEADER_SIZE) | (state) ALLOCATED);
+      set_left_used(right, TRUE_SIZE(head));
+      ARENA_STAT(a, splits, count - 1);
+      return count;
+    }
+  }
+
+  size_t allocated = 0;
+  while (allocated < count) {
+    header *head = allocate_block(a, size, NULL);
+    if (head == NULL) {
+      break;
+    }
+    out[allocated++] = &head->data;
+  }
+  return allocated;
+} /* allocate_batch() */
+
+/*
+ * Allocates the blocks of my_malloc_batch().
+ */
+
+static size_t malloc_batch(size_t size, size_t count, void **out) {
+  if ((size == 0) || (count == 0)) {
+    return 0;
+  }
+
+  if (size > MAX_REQUEST) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  ensure_init();
+
+  size_t block = block_size(size);
+  size_t allocated = 0;
+
+  /* Slab objects and mapped blocks have their own paths */
+
+  if ((size <= SLAB_MAX_SIZE) ||
+      ((MMAP_THRESHOLD > 0) && (block >= MMAP_THRESHOLD))) {
+    while ((allocated < count) &&
+           ((out[allocated] = my_malloc(size)) != NULL)) {
+      allocated++;
+    }
+    return allocated;
+  }
+
+  arena *a = lock_arena();
+  allocated = allocate_batch(a, block, count, out);
+  pthread_mutex_unlock(&a->mutex);
+
+  /* Fall back to arena 0 if another arena's region is exhausted */
+
+  if ((allocated < count) && (a != &g_arenas[0])) {
+    a = &g_arenas[0];
+    acquire_arena(a);
+    allocated += allocate_batch(a, block, count - allocated,
+                                out + allocated);
+    pthread_mutex_unlock(&a->mutex);
+  }
+
+#if MALLOC_STATS
+  for (size_t i = 0; i < allocated; i++) {
+    STAT_ADD(in_use, my_malloc_usable_size(out[i]));
+  }
+#endif
+
+#if MALLOC_TRACE
+  for (size_t i = 0; i < allocated; i++) {
+    TRACE(TRACE_MALLOC, out[i], NULL, size);
+  }
+#endif
+
+  if (allocated < count) {
+    errno = ENOMEM;
+  }
+  return allocated;
+} /* malloc_batch() */
+
+/*
+ * Allocates count blocks of size bytes each, taking the arena lock once.
+ * Heap blocks are carved from one free region, so they are adjacent.
+ *
+ * out: Receives the blocks.
+ *
+ * return: The number of blocks allocated. If it is less than count, errno
+ *   is set to ENOMEM.
+ */
+
+size_t my_malloc_batch(size_t size, size_t count, void **out) {
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+  size_t allocated = malloc_batch(size, count, out);
+  latency_record(LATENCY_MALLOC_BATCH, start);
+  return allocated;
+#else
+  return malloc_batch(size, count, out);
+#endif
+} /* my_malloc_batch() */
+
+/*
+ * Frees count blocks. The lock of each block's arena is held across
+ * consecutive blocks from the same arena, and the blocks go straight back
+ * to the free lists, past any quick list, coalescing with each other.
+ */
+
+void my_free_batch(void **ptrs, size_t count) {
+#if MALLOC_LATENCY
+  uint64_t start = latency_begin();
+#endif
+
+  arena *locked = NULL;
+
+  for (size_t i = 0; i < count; i++) {
+    if (ptrs[i] == NULL) {
+      continue;
+    }
+
+    header *head = (header *) (((char *) ptrs[i]) - ALLOC_HEADER_SIZE);
+
+#if SLAB_MAX_SIZE > 0
+    bool is_slab = object_slab(ptrs[i]) != NULL;
+#else
+    bool is_slab = false;
+#endif
+
+    if (is_slab || (STATE(head) != (state) ALLOCATED)) {
+      my_free(ptrs[i]);
+      continue;
+    }
+
+    arena *a = block_arena(head);
+    if (a != locked) {
+      if (locked != NULL) {
+        pthread_mutex_unlock(&locked->mutex);
+      }
+      acquire_arena(a);
+      locked = a;
+    }
+
+    TRACE(TRACE_FREE, ptrs[i], NULL, 0);
+    STAT_SUB(in_use, usable_size(head));
+    free_block(a, head);
+  }
+
+  if (locked != NULL) {
+    pthread_mutex_unlock(&locked->mutex);
+  }
+
+#if MALLOC_LATENCY
+  latency_record(LATENCY_FREE_BATCH, start);
+#endif
+} /* my_free_batch() */
+
+/*
+ * Adds an arena's system bytes, free blocks, and the free space trimming
+ * could give back to info. Takes the arena's mutex.
+ */
+
+static void add_arena_info(arena *a, struct my_mallinfo2 *info) {
+  pthread_mutex_lock(&a->mutex);
+
+#if MALLOC_STATS
+  info->arena += a->stats.os_bytes;
+#endif
+  info->ordblks += a->free_blocks;
+  info->fordblks += a->free_bytes;
+
+  if (a->last_fence_post != NULL) {
+    header *top = free_left_neighbor(a->last_fence_post);
+    if (top != NULL) {
+      info->keepcost += TRUE_SIZE(top);
+    }
+  }
+
+  pthread_mutex_unlock(&a->mutex);
+} /* add_arena_info() */
+
+/*
+ * Returns the allocator's statistics in the layout of the C library's
+ * mallinfo2(). Free blocks are counted as they are filed and unlinked, so
+ * this does not walk the free lists.
+ */
+
+struct my_mallinfo2 my_mallinfo2(void) {
+  struct my_mallinfo2 info = { 0 };
+
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    add_arena_info(&g_arenas[i], &info);
+  }
+
+#if MALLOC_STATS
+  info.smblks = __atomic_load_n(&g_stats.cached_blocks, __ATOMIC_RELAXED);
+  info.fsmblks = __atomic_load_n(&g_stats.cached_bytes, __ATOMIC_RELAXED);
+  info.hblks = __atomic_load_n(&g_stats.mapped_blocks, __ATOMIC_RELAXED);
+  info.hblkhd = __atomic_load_n(&g_stats.mapped_bytes, __ATOMIC_RELAXED);
+  info.uordblks = __atomic_load_n(&g_stats.in_use, __ATOMIC_RELAXED);
+#endif
+  return info;
+} /* my_mallinfo2() */
+
+/*
+ * Prints the statistics of each arena and the totals to stderr.
+ */
+
+void my_malloc_stats(void) {
+  struct my_mallinfo2 info = my_mallinfo2();
+
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    arena *a = &g_arenas[i];
+    pthread_mutex_lock(&a->mutex);
+    arena_stats stats = a->stats;
+    size_t last_growth = a->last_growth;
+    size_t blocks = a->free_blocks;
+    size_t bytes = a->free_bytes;
+#if QUICK_LIST_CLASSES > 0
+    size_t quick_blocks = a->quick_blocks;
+    size_t quick_bytes = a->quick_bytes;
+#endif
+    pthread_mutex_unlock(&a->mutex);
+
+    fprintf(stderr, "Arena %zu:\n", i);
+    fprintf(stderr, "  system bytes     = %10zu (%zu requests, %zu trims)\n",
+            stats.os_bytes, stats.os_requests, stats.trims);
+    fprintf(stderr, "  growth calls     = %10zu (last grew %zu bytes)\n",
+            stats.grow_calls, last_growth);
+    fprintf(stderr, "  free bytes       = %10zu (%zu blocks)\n", bytes,
+            blocks);
+#if REMOTE_FREE
+    fprintf(stderr, "  remote frees     = %10zu (%zu drains)\n",
+            stats.remote_frees, stats.remote_drains);
+#endif
+#if QUICK_LIST_CLASSES > 0
+    fprintf(stderr, "  quick bytes      = %10zu (%zu blocks, %zu hits, %zu "
+            "merges)\n", quick_bytes, quick_blocks, stats.quick_hits,
+            stats.consolidations);
+#endif
+    fprintf(stderr, "  splits           = %10zu\n", stats.splits);
+    fprintf(stderr, "  coalesces        = %10zu\n", stats.coalesces);
+    fprintf(stderr, "  fit searches     = %10zu (%.2f blocks each, %zu missed)"
+            "\n", stats.fit_searches, stats.fit_searches == 0 ? 0.0 :
+            (double) stats.fit_steps / stats.fit_searches, stats.fit_misses);
+    fprintf(stderr, "  lock acquires    = %10zu (%zu contended, %zu spun, "
+            "%llu cycles waiting)\n", stats.lock_acquires, stats.lock_waits,
+            stats.lock_spins, (unsigned long long) stats.lock_wait_cycles);
+  }
+
+  fprintf(stderr, "Total:\n");
+  fprintf(stderr, "  system bytes     = %10zu\n", info.arena);
+  fprintf(stderr, "  in use bytes     = %10zu\n", info.uordblks);
+  fprintf(stderr, "  free bytes       = %10zu (%zu blocks)\n", info.fordblks,
+          info.ordblks);
+  fprintf(stderr, "  cached bytes     = %10zu (%zu blocks)\n", info.fsmblks,
+          info.smblks);
+  fprintf(stderr, "  mmap bytes       = %10zu (%zu blocks)\n", info.hblkhd,
+          info.hblks);
+} /* my_malloc_stats() */
+
+/*
+ * Calls walker on every header in every chunk of every arena, from each
+ * chunk's left fencepost to its right one. Chunks need not be contiguous,
+ * as they are followed through the links in their left fenceposts.
+ */
+
+void my_heap_walk(my_heap_walker walker, void *arg) {
+  for (size_t i = 0; i < NUM_ARENAS; i++) {
+    arena *a = &g_arenas[i];
+    acquire_arena(a);
+
+    for (header *chunk = a->first_chunk; chunk != NULL;
+         chunk = next_chunk(chunk)) {
+      header *h = chunk;
+      walker(h, i, arg);
+      do {
+        h = right_neighbor(h);
+        walker(h, i, arg);
+      } while (STATE(h) != (state) FENCEPOST);
+    }
+
+    pthread_mutex_unlock(&a->mutex);
+  }
+} /* my_heap_walk() */
+
+/* A heap report being filled in, and whether the walk is inside a chunk */
+
+typedef struct report_walk {
+  struct my_heap_report *report;
+  bool in_chunk;
+} report_walk;
+
+/*
+ * Adds a header to a heap report. Fenceposts come in pairs, the first
+ * opening a chunk and the second closing it.
+ */
+
+static void report_block(header *block, size_t arena, void *arg) {
+  (void) arena;
+  report_walk *walk = (report_walk *) arg;
+  struct my_heap_report *report = walk->report;
+  size_t size = TRUE_SIZE(block) + ALLOC_HEADER_SIZE;
+  heap_chunk_report *chunk = NULL;
+  if ((report->chunks > 0) && (report->chunks <= HEAP_REPORT_CHUNKS)) {
+    chunk = &report->chunk[report->chunks - 1];
+  }
+
+  switch (STATE(block)) {
+    case FENCEPOST:
+      if (!walk->in_chunk) {
+        if (report->chunks < HEAP_REPORT_CHUNKS) {
+          report->chunk[report->chunks].start = block;
+        }
+        report->chunks++;
+      }
+      else if (chunk != NULL) {
+        chunk->size = (char *) block + ALLOC_HEADER_SIZE -
+                      (char *) chunk->start;
+      }
+      walk->in_chunk = !walk->in_chunk;
+      break;
+    case UNALLOCATED:
+      report->free_blocks++;
+      report->free_bytes += TRUE_SIZE(block);
+      if (TRUE_SIZE(block) > report->largest_free) {
+        report->largest_free = TRUE_SIZE(block);
+      }
+      report->histogram[8 * sizeof(size_t) - 1 -
+                        __builtin_clzl(TRUE_SIZE(block))]++;
+      if (chunk != NULL) {
+        chunk->free += size;
+      }
+      break;
+    default:
+      if (chunk != NULL) {
+        chunk->used += size;
+      }
+      break;
+  }
+} /* report_block() */
+
+/*
+ * Fills in a report of how fragmented the heaps' free space is.
+ */
+
+void my_heap_report(struct my_heap_report *report) {
+  memset(report, 0, sizeof(*report));
+  report_walk walk = { report, false };
+  my_heap_walk(report_block, &walk);
+
+  if (report->free_bytes > 0) {
+    report->fragmentation = 1.0 -
+      (double) report->largest_free / report->free_bytes;
+  }
+} /* my_heap_report() */
+
+/*
+ * Prints a heap report to stderr.
+ */
+
+void my_heap_report_print(const struct my_heap_report *report) {
+  fprintf(stderr, "Heap:\n");
+  fprintf(stderr, "  free bytes       = %10zu (%zu blocks)\n",
+          report->free_bytes, report->free_blocks);
+  fprintf(stderr, "  largest free     = %10zu\n", report->largest_free);
+  fprintf(stderr, "  fragmentation    = %10.4f\n", report->fragmentation);
+
+  for (size_t i = 0; i < sizeof(report->histogram) / sizeof(size_t); i++) {
+    if (report->histogram[i] != 0) {
+      fprintf(stderr, "  free [2^%zu, 2^%zu) = %8zu\n", i, i + 1,
+              report->histogram[i]);
+    }
+  }
+
+  for (size_t i = 0; (i < report->chunks) && (i < HEAP_REPORT_CHUNKS); i++) {
+    const heap_chunk_report *chunk = &report->chunk[i];
+    fprintf(stderr, "  chunk %p: %zu bytes, %zu used (%.1f%%), %zu free\n",
+            chunk->start, chunk->size, chunk->used,
+            100.0 * chunk->used / chunk->size, chunk->free);
+  }
+  if (report->chunks > HEAP_REPORT_CHUNKS) {
+    fprintf(stderr, "  %zu more chunks\n",
+            report->chunks - HEAP_REPORT_CHUNKS);
+  }
+} /* my_heap_report_print() */
+
+#if MALLOC_LATENCY
+
+/*
+ * Fills in a summary from a histogram of one kind of call.
+ */
+
+static void latency_summarize(latency_summary *summary,
+                              const uint64_t *counts, uint64_t max) {
+  uint64_t calls = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    calls += counts[i];
+  }
+  summary->calls = calls;
+  summary->max = max;
+
+  const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+  uint64_t *percentiles[] = { &summary->p50, &summary->p90, &summary->p99,
+                              &summary->p999 };
+  uint64_t seen = 0;
+  size_t bucket = 0;
+  for (size_t p = 0; p < sizeof(fractions) / sizeof(double); p++) {
+
+    /* The percentile is the first bucket that holds more than its share of
+     * the calls */
+
+    uint64_t rank = (uint64_t) (fractions[p] * calls);
+    while ((bucket < LATENCY_BUCKETS) && (seen + counts[bucket] <= rank)) {
+      seen += counts[bucket];
+      bucket++;
+    }
+    uint64_t end = latency_bucket_end(bucket);
+    *percentiles[p] = calls == 0 ? 0 : (end < max ? end : max);
+  }
+} /* latency_summarize() */
+
+#endif
+
+/*
+ * Sums the latency histograms of every thread, and those that have
+ * exited, into percentiles.
+ */
+
+void my_latency_snapshot(struct my_latency *snapshot) {
+  memset(snapshot, 0, sizeof(*snapshot));
+
+#if MALLOC_LATENCY
+  static latency_histogram total;
+
+  pthread_mutex_lock(&g_latency_mutex);
+  memset(&total, 0, sizeof(total));
+  latency_add(&total, &g_latency_exited);
+  for (latency_histogram *h = g_latency_threads; h != NULL; h = h->next) {
+    latency_add(&total, h);
+  }
+
+  for (size_t op = 0; op < LATENCY_OPS; op++) {
+    latency_summarize(&snapshot->ops[op], total.counts[op], total.max[op]);
+  }
+  for (size_t i = 0; i < LATENCY_EVENTS; i++) {
+    snapshot->events[i] = total.events[i];
+    snapshot->event_cycles[i] = total.event_cycles[i];
+  }
+  pthread_mutex_unlock(&g_latency_mutex);
+#endif
+} /* my_latency_snapshot() */
+
+/*
+ * Empties every thread's latency histograms.
+ */
+
+void my_latency_reset(void) {
+#if MALLOC_LATENCY
+  pthread_mutex_lock(&g_latency_mutex);
+  memset(&g_latency_exited, 0, sizeof(g_latency_exited));
+  for (latency_histogram *h = g_latency_threads; h != NULL; h = h->next) {
+    for (size_t op = 0; op < LATENCY_OPS; op++) {
+      for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        __atomic_store_n(&h->counts[op][i], 0, __ATOMIC_RELAXED);
+      }
+      __atomic_store_n(&h->max[op], 0, __ATOMIC_RELAXED);
+    }
+    for (size_t i = 0; i < LATENCY_EVENTS; i++) {
+      __atomic_store_n(&h->events[i], 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&h->event_cycles[i], 0, __ATOMIC_RELAXED);
+    }
+  }
+  pthread_mutex_unlock(&g_latency_mutex);
+#endif
+} /* my_latency_reset() */
+
+/*
+ * Prints a latency snapshot to stderr.
+ */
+
+void my_latency_print(const struct my_latency *snapshot) {
+  const char *ops[] = { "malloc", "free", "calloc", "realloc", "memalign",
+                        "malloc batch", "free batch" };
+  const char *events[] = { "sbrk", "mmap", "full scan", "coalesce both",
+                           "lock wait" };
+
+  fprintf(stderr, "Latency (cycles):\n");
+  for (size_t op = 0; op < LATENCY_OPS; op++) {
+    const latency_summary *s = &snapshot->ops[op];
+    fprintf(stderr, "  %-14s %10llu calls  p50 %llu  p90 %llu  p99 %llu  "
+            "p99.9 %llu  max %llu\n", ops[op],
+            (unsigned long long) s->calls, (unsigned long long) s->p50,
+            (unsigned long long) s->p90, (unsigned long long) s->p99,
+            (unsigned long long) s->p999, (unsigned long long) s->max);
+  }
+  for (size_t i = 0; i < LATENCY_EVENTS; i++) {
+    fprintf(stderr, "  %-14s %10llu calls  %.0f each\n", events[i],
+            (unsigned long long) snapshot->events[i],
+            snapshot->events[i] == 0 ? 0.0 :
+            (double) snapshot->event_cycles[i] / snapshot->events[i]);
+  }
+} /* my_latency_print() */
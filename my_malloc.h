@@ -2,6 +2,10 @@
 #define MY_MALLOC_H
 
 #include <sys/types.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #ifndef MIN_ALLOCATION
 #define MIN_ALLOCATION (8)
@@ -11,6 +15,45 @@
 #define ARENA_SIZE (4096)
 #endif
 
+/*
+ * Set to store a block's size and left_size in 32 bits
+ * each, so a header takes 8 bytes on 64-bit builds
+ * instead of 16 (32-bit builds already use 8). The top
+ * bit of size is then PREV_INUSE: while it is set, the
+ * left neighbor is in use and left_size is the last
+ * word of its data, so an allocated block holds 4 bytes
+ * more than its size. No request may exceed MAX_REQUEST
+ * (1 GB), and no chunk may reach 2 GB.
+ *
+ * 0 = size_t sizes, and every block keeps its left_size
+ */
+
+#ifndef COMPACT_HEADER
+#define COMPACT_HEADER (0)
+#endif
+
+/* Largest request the heap accepts */
+
+#if COMPACT_HEADER
+#define MAX_REQUEST ((size_t) 1 << 30)
+#else
+#define MAX_REQUEST (SIZE_MAX / 2)
+#endif
+
+/*
+ * Set to link free blocks through 32-bit offsets from
+ * the start of their arena's heap instead of pointers,
+ * so a free block needs 8 bytes for its links and the
+ * smallest block halves on 64-bit builds. Arena 0 then
+ * refuses to grow past 4 GB above g_base.
+ *
+ * 0 = Pointer links
+ */
+
+#ifndef OFFSET_LINKS
+#define OFFSET_LINKS (0)
+#endif
+
 /*
  * Defines the algorithm that will
  * be used to select the free block.
@@ -19,24 +62,411 @@
  * 2 = Next Fit
  * 3 = Best Fit
  * 4 = Worst Fit
+ * 5 = Two-Level Segregated Fit (TLSF)
+ *
+ * Algorithms 1-4 are only the default: the MY_MALLOC_FIT
+ * environment variable or my_mallopt(M_FIT_ALGORITHM)
+ * selects another, or FIT_ADAPTIVE, at runtime.
  */
 #ifndef FIT_ALGORITHM
 #define FIT_ALGORITHM (1)
 #endif
 
-#define ALLOC_HEADER_SIZE (sizeof(header) - (2 * sizeof(header *)))
+/*
+ * The adaptive fit policy looks at each arena's last
+ * ADAPT_WINDOW searches. If more than ADAPT_MISS_PERCENT
+ * of them searched free blocks and found none to fit, the
+ * free space is fragmented and best fit is used. Otherwise
+ * if a search looked at more than ADAPT_MAX_STEPS blocks on
+ * average the lists are long, and next fit is used. First
+ * fit is used for everything else. The policy keeps its
+ * own counts, so it works without MALLOC_STATS.
+ */
+#ifndef ADAPT_WINDOW
+#define ADAPT_WINDOW (1024)
+#endif
+
+#ifndef ADAPT_MISS_PERCENT
+#define ADAPT_MISS_PERCENT (5)
+#endif
+
+#ifndef ADAPT_MAX_STEPS
+#define ADAPT_MAX_STEPS (16)
+#endif
+
+/*
+ * TLSF files free blocks under a first level (power of
+ * two size range) and a second level (TLSF_SL_COUNT
+ * linear steps within that range). Bitmaps of the
+ * non-empty lists let a fit be found with find-first-set
+ * instead of a search, so malloc and free take bounded
+ * time. The lists are the regular free lists, so
+ * N_LISTS is derived from the two levels.
+ */
+
+#if FIT_ALGORITHM == 5
+
+#ifdef N_LISTS
+#error "N_LISTS is derived from TLSF_SL_LOG2 when FIT_ALGORITHM is 5"
+#endif
+
+#ifndef TLSF_SL_LOG2
+#define TLSF_SL_LOG2 (4)
+#endif
+
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT (sizeof(size_t) * 8)
+#define N_LISTS (TLSF_FL_COUNT * TLSF_SL_COUNT)
+
+#endif
+
+/*
+ * Number of segregated free lists. All lists but the
+ * last hold blocks within a single MIN_ALLOCATION step,
+ * so small requests are usually served by the head of
+ * their list. The last list holds all larger blocks.
+ *
+ * 1 = A single free list
+ */
+
+#ifndef N_LISTS
+#define N_LISTS (1)
+#endif
+
+/*
+ * Number of freed blocks each thread keeps per size
+ * class, so small blocks are recycled without taking
+ * the global lock. The cache is refilled from and
+ * flushed to the heap THREAD_CACHE_BATCH blocks at a
+ * time, and returned to the heap when the thread exits.
+ *
+ * 0 = No thread cache
+ */
+
+#ifndef THREAD_CACHE_SIZE
+#define THREAD_CACHE_SIZE (0)
+#endif
+
+#ifndef THREAD_CACHE_BATCH
+#define THREAD_CACHE_BATCH ((THREAD_CACHE_SIZE + 1) / 2)
+#endif
+
+/* Number of size classes, in MIN_ALLOCATION steps */
+
+#ifndef THREAD_CACHE_CLASSES
+#define THREAD_CACHE_CLASSES (32)
+#endif
+
+/*
+ * Number of quick lists per arena, one per size class
+ * in MIN_ALLOCATION steps. A freed block in one of the
+ * classes is pushed on its list without coalescing. It
+ * stays marked QUICK, so its neighbors treat it as
+ * allocated, and the next request of its size pops it.
+ * The lists are merged into the free lists only when a
+ * fit search fails, when they hold more than
+ * QUICK_LIST_MAX_BYTES, or when the heap is trimmed.
+ *
+ * 0 = Free blocks are coalesced right away
+ */
+
+#ifndef QUICK_LIST_CLASSES
+#define QUICK_LIST_CLASSES (0)
+#endif
+
+#ifndef QUICK_LIST_MAX_BYTES
+#define QUICK_LIST_MAX_BYTES (64 * 1024)
+#endif
+
+/*
+ * Number of independent heaps (arenas), each with its
+ * own free lists, fenceposts and lock. Threads are
+ * spread across them round robin, and move to another
+ * arena when their own arena's lock is busy.
+ *
+ * Arena 0 grows with sbrk(). The others carve their
+ * chunks out of an ARENA_HEAP_SIZE region from mmap(),
+ * aligned to its size so that the arena owning a block
+ * can be found from the block's address.
+ *
+ * 1 = A single heap
+ */
+
+#ifndef NUM_ARENAS
+#define NUM_ARENAS (1)
+#endif
+
+#ifndef ARENA_HEAP_SIZE
+#define ARENA_HEAP_SIZE (64 * 1024 * 1024)
+#endif
+
+/*
+ * Set to let a thread free a block of another arena
+ * than its own without that arena's lock: the block is
+ * pushed on the arena's remote free list with a compare
+ * and swap, and stays ALLOCATED to its neighbors. The
+ * arena takes the whole list back the next time a
+ * thread locks it to allocate, or a fit search in it
+ * fails. A thread that has not allocated yet frees
+ * under the lock. A block freed twice before then is
+ * not caught.
+ *
+ * 0 = Every free takes its block's arena lock
+ */
+
+#ifndef REMOTE_FREE
+#define REMOTE_FREE (0)
+#endif
+
+/*
+ * Times a thread that finds an arena's lock busy tries
+ * it again before sleeping in the kernel. It pauses
+ * between tries, twice as long each time up to
+ * LOCK_BACKOFF_MAX pauses. Spinning is skipped when
+ * only one CPU is online, as the holder cannot run.
+ *
+ * 0 = Sleep at once
+ */
+
+#ifndef LOCK_SPIN_LIMIT
+#define LOCK_SPIN_LIMIT (100)
+#endif
 
-#define TRUE_SIZE(x) ((x->size) & ~0b111)
+#ifndef LOCK_BACKOFF_MAX
+#define LOCK_BACKOFF_MAX (64)
+#endif
+
+/*
+ * Requests of at least this many bytes are served by
+ * their own anonymous mmap() instead of the heap, and
+ * unmapped as soon as they are freed. This keeps huge
+ * buffers from fragmenting the heap and returns their
+ * memory to the OS.
+ *
+ * 0 = Always use the heap
+ */
+
+#ifndef MMAP_THRESHOLD
+#define MMAP_THRESHOLD (128 * 1024)
+#endif
+
+/*
+ * Once the free block at the top of a heap reaches this
+ * many bytes, my_free() gives it back to the OS with a
+ * negative sbrk(). my_malloc_trim() does the same on
+ * demand.
+ *
+ * 0 = Only trim through my_malloc_trim()
+ */
+
+#ifndef TRIM_THRESHOLD
+#define TRIM_THRESHOLD (128 * 1024)
+#endif
+
+/*
+ * How an arena grows. It asks the OS for the request
+ * plus GROWTH_TOP_PAD bytes, and at least GROWTH_MIN,
+ * rounded up to ARENA_SIZE. With GROWTH_PERCENT above
+ * 100, each growth is also at least that percentage of
+ * the arena's previous one, up to GROWTH_MAX, so a heap
+ * ramping up to gigabytes makes a logarithmic number of
+ * sbrk() calls. The automatic trim keeps the top at
+ * least this large. my_mallopt() changes all four at
+ * runtime.
+ *
+ * 0 = GROWTH_PERCENT off: grow by what is needed
+ */
+
+#ifndef GROWTH_PERCENT
+#define GROWTH_PERCENT (0)
+#endif
+
+#ifndef GROWTH_MAX
+#define GROWTH_MAX (32 * 1024 * 1024)
+#endif
+
+#ifndef GROWTH_MIN
+#define GROWTH_MIN (ARENA_SIZE)
+#endif
+
+#ifndef GROWTH_TOP_PAD
+#define GROWTH_TOP_PAD (0)
+#endif
+
+/*
+ * Requests of at most this many bytes are served from
+ * slabs: SLAB_SIZE pages holding objects of a single
+ * size class, with a bitmap of the free objects and no
+ * header per object. Slabs are carved from a region
+ * from mmap(), aligned to SLAB_HEAP_SIZE, so my_free()
+ * recognizes an object and finds its slab from its
+ * address alone. Once the region is full, requests
+ * fall back to the heap.
+ *
+ * 0 = No slabs
+ */
+
+#ifndef SLAB_MAX_SIZE
+#define SLAB_MAX_SIZE (0)
+#endif
+
+#ifndef SLAB_SIZE
+#define SLAB_SIZE (16 * 1024)
+#endif
+
+#ifndef SLAB_HEAP_SIZE
+#define SLAB_HEAP_SIZE (64 * 1024 * 1024)
+#endif
+
+/*
+ * my_calloc() clears blocks of at least this many bytes
+ * with non-temporal stores, so zeroing a large buffer
+ * does not evict the rest of the cache. Only used when
+ * the target has SSE2.
+ *
+ * 0 = Always use memset()
+ */
+
+#ifndef STREAM_ZERO_THRESHOLD
+#define STREAM_ZERO_THRESHOLD (256 * 1024)
+#endif
+
+/*
+ * Set to make my_free_sized() check a block's header
+ * against the size it is given, and abort if they do not
+ * match. Follows assert() by default.
+ *
+ * 0 = Trust the caller's size
+ */
+
+#ifndef FREE_SIZED_CHECK
+#ifdef NDEBUG
+#define FREE_SIZED_CHECK (0)
+#else
+#define FREE_SIZED_CHECK (1)
+#endif
+#endif
+
+/*
+ * Keeps the counters reported by my_mallinfo2() and
+ * my_malloc_stats(). Each arena counts its own events
+ * under its mutex. Bytes in use, mapped and cached are
+ * global counters updated with relaxed atomics.
+ *
+ * 0 = No statistics
+ */
+
+#ifndef MALLOC_STATS
+#define MALLOC_STATS (1)
+#endif
+
+/*
+ * Records every call that allocates or frees a block
+ * (the aligned, batch and sized variants included) to
+ * MALLOC_TRACE_FILE, or the file named
+ * by the MY_MALLOC_TRACE environment variable. Each thread
+ * fills a buffer of TRACE_BUFFER_SIZE records and appends
+ * it to the file when it is full or the thread exits.
+ * Forked children are not traced, and a program that is
+ * exec'd starts the file over. trace_replay runs a trace
+ * again.
+ *
+ * 0 = No tracing
+ */
+
+#ifndef MALLOC_TRACE
+#define MALLOC_TRACE (0)
+#endif
+
+#ifndef MALLOC_TRACE_FILE
+#define MALLOC_TRACE_FILE "malloc.trace"
+#endif
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE (1024)
+#endif
+
+/*
+ * Measures the cycles each allocation and free call
+ * takes (nanoseconds where there is no cycle counter) into
+ * per-thread log-linear histograms, and counts the calls
+ * that took a slow path. my_latency_snapshot() sums the
+ * threads' histograms into percentiles.
+ *
+ * 0 = No latency histograms
+ */
+
+#ifndef MALLOC_LATENCY
+#define MALLOC_LATENCY (0)
+#endif
+
+/* Each power of two is split into 2^LATENCY_SUB_LOG2 buckets, so a
+ * percentile is within 1 / 2^LATENCY_SUB_LOG2 of the true value */
+
+#ifndef LATENCY_SUB_LOG2
+#define LATENCY_SUB_LOG2 (3)
+#endif
+
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_LOG2 + 1) << LATENCY_SUB_LOG2)
+
+#define ALLOC_HEADER_SIZE (offsetof(header, data))
+
+/* Set in a compact header's size while the left neighbor is allocated,
+ * cached or quick. It is not part of the size */
+
+#if COMPACT_HEADER
+#define PREV_INUSE ((uint32_t) 1 << 31)
+#else
+#define PREV_INUSE (0)
+#endif
+
+/* Bytes of its right neighbor's header an allocated heap block's data
+ * covers: the left_size, with compact headers */
+
+#if COMPACT_HEADER
+#define LEFT_SIZE_OVERLAP (sizeof(uint32_t))
+#else
+#define LEFT_SIZE_OVERLAP (0)
+#endif
+
+#define TRUE_SIZE(x) ((x->size) & ~(0b111 | PREV_INUSE))
+
+#define STATE(x) ((x->size) & 0b111)
+
+/* Smallest block size able to hold the free list links */
+
+#define MIN_BLOCK_SIZE (sizeof(header) - ALLOC_HEADER_SIZE)
+
+/* Largest block size kept on a quick list */
+
+#define QUICK_LIST_MAX_SIZE \
+  (MIN_BLOCK_SIZE + (QUICK_LIST_CLASSES - 1) * MIN_ALLOCATION)
+
+/* Largest block size served by the thread cache */
+
+#define THREAD_CACHE_MAX_SIZE \
+  (MIN_BLOCK_SIZE + (THREAD_CACHE_CLASSES - 1) * MIN_ALLOCATION)
 
 /* The 3 least significant bits in
  * the block size field are used
  * to store allocation state.
+ *
+ * CACHED blocks sit in a thread cache,
+ * QUICK blocks on an arena's quick list.
+ * Their neighbors treat them as allocated.
+ *
+ * MMAPPED blocks have a mapping of their own
+ * and no neighbors. Their left_size holds
+ * the length of the mapping.
  */
 
 typedef enum state {
   UNALLOCATED = 0b000,
   ALLOCATED = 0b001,
   FENCEPOST = 0b010,
+  MMAPPED = 0b011,
+  CACHED = 0b101,
+  QUICK = 0b111,
 } state;
 
 typedef struct header {
@@ -45,17 +475,180 @@ typedef struct header {
    * that header takes ALLOC_HEADER_SIZE
    */
 
+#if COMPACT_HEADER
+
+  /* left_size comes first, right after the left neighbor's data, so that
+   * the neighbor can use it while it is allocated */
+
+  uint32_t left_size;
+  uint32_t size;
+#else
   size_t size;
   size_t left_size;
+#endif
   union {
+#if OFFSET_LINKS
+
+    /* Free list links, as offsets from the arena's heap base (0 = none) */
+
+    struct {
+      uint32_t next_link;
+      uint32_t prev_link;
+    };
+
+    /* Quick list, remote list and thread cache link */
+
+    struct header *next;
+#else
     struct {
       struct header *next;
       struct header *prev;
     };
+#endif
     char *data;
   };
 } header;
 
+/* Events counted by an arena, under its mutex */
+
+typedef struct arena_stats {
+
+  /* Chunks and bytes obtained from the OS, net of trimming */
+
+  size_t os_requests;
+  size_t os_bytes;
+  size_t trims;
+
+  /* Calls to grow the heap, failed ones included */
+
+  size_t grow_calls;
+
+  size_t splits;
+  size_t coalesces;
+
+  /* Free list searches, and the free blocks they looked at */
+
+  size_t fit_searches;
+  size_t fit_steps;
+
+  /* Searches that looked at free blocks and found none that fit */
+
+  size_t fit_misses;
+
+  /* Requests served from a quick list, and times the lists were merged
+   * into the free lists */
+
+  size_t quick_hits;
+  size_t consolidations;
+
+  /* Blocks other threads pushed on the remote free list, and times the
+   * arena took the list back */
+
+  size_t remote_frees;
+  size_t remote_drains;
+
+  /* Times the arena's mutex was taken, times it was busy, and of those,
+   * times it was taken while spinning rather than asleep */
+
+  size_t lock_acquires;
+  size_t lock_waits;
+  size_t lock_spins;
+
+  /* Cycles threads spent waiting for the mutex */
+
+  uint64_t lock_wait_cycles;
+} arena_stats;
+
+typedef struct arena {
+  pthread_mutex_t mutex;
+
+  /* Heads of the segregated free lists */
+
+  header *freelists[N_LISTS];
+
+  /* Blocks on the free lists and their total size, kept as they are filed,
+   * unlinked and resized */
+
+  size_t free_blocks;
+  size_t free_bytes;
+
+  /* Right fencepost of the arena's most recent chunk */
+
+  header *last_fence_post;
+
+  /* Left fenceposts of the arena's first and last chunks. Nothing lies to
+   * the left of a left fencepost, so its left_size links to the next
+   * chunk's instead */
+
+  header *first_chunk;
+  header *last_chunk;
+
+  /* Where next fit resumes its search */
+
+  header *next_allocate;
+
+  /* Bytes the arena last grew by, which geometric growth scales up */
+
+  size_t last_growth;
+
+#if FIT_ALGORITHM != 5
+
+  /* The search for a free block, for the arena's current fit algorithm */
+
+  header *(*find)(struct arena *a, size_t size);
+
+  /* Set if adapt_fit() picks the algorithm, from the searches, steps and
+   * misses counted since the window started */
+
+  bool adaptive;
+  size_t window_searches;
+  size_t window_steps;
+  size_t window_misses;
+#endif
+
+#if FIT_ALGORITHM == 5
+
+  /* Bit i is set if first level i has a non-empty list */
+
+  size_t tlsf_fl_bitmap;
+
+  /* Bit j of entry i is set if the list at (i, j) is non-empty */
+
+  unsigned int tlsf_sl_bitmap[TLSF_FL_COUNT];
+#endif
+
+#if QUICK_LIST_CLASSES > 0
+
+  /* Freed blocks not yet coalesced, singly linked through next, and their
+   * totals */
+
+  header *quick[QUICK_LIST_CLASSES];
+  size_t quick_blocks;
+  size_t quick_bytes;
+#endif
+
+#if REMOTE_FREE
+
+  /* Blocks freed by threads using other arenas, singly linked through
+   * next. Pushed without the mutex, taken back all at once under it */
+
+  header *remote;
+#endif
+
+  /* Everything at or above clean has not been written since it came from
+   * the OS, apart from the headers and free list pointers of the blocks
+   * that start there */
+
+  char *clean;
+
+  arena_stats stats;
+
+  /* The mmap() region chunks are carved from (NULL for arena 0) */
+
+  char *heap_start;
+  char *heap_top;
+} arena;
+
 /* Variations of the malloc function.
  * You only need to implement malloc and free.
  */
@@ -65,13 +658,197 @@ void *my_calloc(size_t nmemb, size_t size);
 void *my_realloc(void *ptr, size_t size);
 void my_free(void *p);
 
+/* Allocations aligned to a power of two */
+
+void *my_memalign(size_t alignment, size_t size);
+int my_posix_memalign(void **memptr, size_t alignment, size_t size);
+void *my_aligned_alloc(size_t alignment, size_t size);
+
+/* Allocate or free many blocks under a single lock acquisition */
+
+size_t my_malloc_batch(size_t size, size_t count, void **out);
+void my_free_batch(void **ptrs, size_t count);
+
+/* Returns the usable size of an allocated block */
+
+size_t my_malloc_usable_size(void *p);
+
+/* Frees a block, trusting the caller for its size */
+
+void my_free_sized(void *p, size_t size);
+
+/* Same fields as the C library's struct mallinfo2 */
+
+struct my_mallinfo2 {
+  size_t arena;     /* Bytes obtained from the OS for the heaps */
+  size_t ordblks;   /* Free blocks */
+  size_t smblks;    /* Blocks in thread caches, quick and remote lists */
+  size_t hblks;     /* Mapped blocks */
+  size_t hblkhd;    /* Bytes in mapped blocks */
+  size_t usmblks;   /* Always 0 */
+  size_t fsmblks;   /* Bytes in thread caches, quick and remote lists */
+  size_t uordblks;  /* Bytes allocated to the user */
+  size_t fordblks;  /* Bytes in free blocks */
+  size_t keepcost;  /* Bytes that trimming could release */
+};
+
+/* Allocator statistics */
+
+struct my_mallinfo2 my_mallinfo2(void);
+void my_malloc_stats(void);
+
+typedef enum trace_op {
+  TRACE_MALLOC,
+  TRACE_CALLOC,
+  TRACE_REALLOC,
+  TRACE_FREE,
+  TRACE_MEMALIGN,
+} trace_op;
+
+/* One call in a trace. Pointers are stored in 64 bits whatever the build,
+ * and identify blocks until they are freed */
+
+typedef struct trace_record {
+  uint64_t time;      /* Nanoseconds on the monotonic clock */
+  uint64_t ptr;       /* The block returned, or the one freed */
+  uint64_t old_ptr;   /* The block passed to my_realloc(), or the
+                         alignment passed to my_memalign() */
+  uint64_t size;      /* Bytes requested, the product for my_calloc() */
+  uint32_t thread;    /* Threads are numbered as they first allocate */
+  uint32_t op;
+} trace_record;
+
+/* Calls that are timed. my_free_sized() counts as LATENCY_FREE, and
+ * my_posix_memalign() and my_aligned_alloc() as LATENCY_MEMALIGN. The
+ * my_malloc() and my_free() calls made inside another call are part of
+ * that call */
+
+typedef enum latency_op {
+  LATENCY_MALLOC,
+  LATENCY_FREE,
+  LATENCY_CALLOC,
+  LATENCY_REALLOC,
+  LATENCY_MEMALIGN,
+  LATENCY_MALLOC_BATCH,
+  LATENCY_FREE_BATCH,
+  LATENCY_OPS,
+} latency_op;
+
+/* Slow paths a call can take */
+
+typedef enum latency_event {
+  LATENCY_SBRK,           /* An arena grew */
+  LATENCY_MMAP,           /* A block was mapped or unmapped */
+  LATENCY_FULL_SCAN,      /* A fit search walked a whole free list */
+  LATENCY_COALESCE_BOTH,  /* A freed block joined both neighbors */
+  LATENCY_LOCK_WAIT,      /* An arena's mutex was contended */
+  LATENCY_EVENTS,
+} latency_event;
+
+/* Cycles per call, each percentile rounded up to its bucket's end */
+
+typedef struct latency_summary {
+  uint64_t calls;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t p999;
+  uint64_t max;
+} latency_summary;
+
+struct my_latency {
+  latency_summary ops[LATENCY_OPS];
+
+  /* The calls that took each slow path, and the cycles they took */
+
+  uint64_t events[LATENCY_EVENTS];
+  uint64_t event_cycles[LATENCY_EVENTS];
+};
+
+/* Latency of all threads since the last reset (all zero without
+ * MALLOC_LATENCY) */
+
+void my_latency_snapshot(struct my_latency *snapshot);
+void my_latency_reset(void);
+void my_latency_print(const struct my_latency *snapshot);
+
+/* Calls walker on every header in every heap chunk, fenceposts included,
+ * holding the arena's mutex. The walker must not allocate or free */
+
+typedef void (*my_heap_walker)(header *block, size_t arena, void *arg);
+
+void my_heap_walk(my_heap_walker walker, void *arg);
+
+/* Chunks past this many are counted but not described in a heap report */
+
+#ifndef HEAP_REPORT_CHUNKS
+#define HEAP_REPORT_CHUNKS (32)
+#endif
+
+typedef struct heap_chunk_report {
+  void *start;      /* Left fencepost */
+  size_t size;      /* Bytes from the left fencepost to the right one's end */
+  size_t used;      /* Bytes in allocated and cached blocks, headers included */
+  size_t free;      /* Bytes in free blocks, headers included */
+} heap_chunk_report;
+
+struct my_heap_report {
+  size_t chunks;
+  size_t free_blocks;
+  size_t free_bytes;
+  size_t largest_free;
+
+  /* 1 - largest_free / free_bytes: 0 when all free space is one block */
+
+  double fragmentation;
+
+  /* Entry i counts the free blocks whose size has its top bit at i */
+
+  size_t histogram[sizeof(size_t) * 8];
+
+  heap_chunk_report chunk[HEAP_REPORT_CHUNKS];
+};
+
+/* Fragmentation of the heaps, leaving out mapped blocks and slabs */
+
+void my_heap_report(struct my_heap_report *report);
+void my_heap_report_print(const struct my_heap_report *report);
+
+/* my_mallopt() parameters, away from the C library's */
+
+#define M_FIT_ALGORITHM (-200)
+#define M_GROWTH_PERCENT (-201)
+#define M_GROWTH_MAX (-202)
+#define M_GROWTH_MIN (-203)
+#define M_GROWTH_TOP_PAD (-204)
+
+/* The value of M_FIT_ALGORITHM that lets each arena pick its own */
+
+#define FIT_ADAPTIVE (0)
+
+/* Sets a parameter at runtime. Returns 1 on success and 0 on error */
+
+int my_mallopt(int param, int value);
+
+/* Returns free memory at the top of the heap to the OS */
+
+int my_malloc_trim(size_t pad);
+
 /*
  * Global variable declarations
  */
 
-extern header *g_freelist_head;
-extern header *g_last_fencepost;
-extern header *g_next_allocate;
+extern arena g_arenas[NUM_ARENAS];
 extern void *g_base;
 
+/* The state of arena 0, the sbrk() heap */
+
+#define g_freelists (g_arenas[0].freelists)
+#define g_last_fence_post (g_arenas[0].last_fence_post)
+#define g_next_allocate (g_arenas[0].next_allocate)
+
+/* The first free list (the only one when N_LISTS is 1) */
+
+#define g_freelist_head (g_freelists[0])
+
 #endif
@@ -0,0 +1,112 @@
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "my_malloc.h"
+
+/*
+ * Defines the standard allocation functions on top of the my_ versions, so
+ * the allocator can replace the C library's in an unmodified program:
+ *
+ *   make preload
+ *   LD_PRELOAD=./libmymalloc.so program
+ *
+ * The library is built with MALLOC_PRELOAD, which leaves stdout's buffering
+ * alone.
+ */
+
+/*
+ * Programs expect malloc(0) to return a unique pointer, so zero byte
+ * requests are given the smallest block.
+ */
+
+void *malloc(size_t size) {
+  return my_malloc(size == 0 ? 1 : size);
+} /* malloc() */
+
+void free(void *ptr) {
+  my_free(ptr);
+} /* free() */
+
+void free_sized(void *ptr, size_t size) {
+  my_free_sized(ptr, size);
+} /* free_sized() */
+
+void *calloc(size_t nmemb, size_t size) {
+  if ((nmemb == 0) || (size == 0)) {
+    nmemb = 1;
+    size = 1;
+  }
+  return my_calloc(nmemb, size);
+} /* calloc() */
+
+void *realloc(void *ptr, size_t size) {
+  return my_realloc(ptr, size);
+} /* realloc() */
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+  return my_posix_memalign(memptr, alignment, size == 0 ? 1 : size);
+} /* posix_memalign() */
+
+void *memalign(size_t alignment, size_t size) {
+  return my_memalign(alignment, size == 0 ? 1 : size);
+} /* memalign() */
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  return my_aligned_alloc(alignment, size == 0 ? 1 : size);
+} /* aligned_alloc() */
+
+void *valloc(size_t size) {
+  return my_memalign(sysconf(_SC_PAGESIZE), size == 0 ? 1 : size);
+} /* valloc() */
+
+void *pvalloc(size_t size) {
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  if (size > SIZE_MAX - page_size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  size = (size + page_size - 1) & ~(page_size - 1);
+  return my_memalign(page_size, size == 0 ? page_size : size);
+} /* pvalloc() */
+
+size_t malloc_usable_size(void *ptr) {
+  return my_malloc_usable_size(ptr);
+} /* malloc_usable_size() */
+
+int malloc_trim(size_t pad) {
+  return my_malloc_trim(pad);
+} /* malloc_trim() */
+
+/*
+ * Only the allocator's own parameters can be set, so the C library's fail.
+ */
+
+int mallopt(int param, int value) {
+  return my_mallopt(param, value);
+} /* mallopt() */
+
+void malloc_stats(void) {
+  my_malloc_stats();
+} /* malloc_stats() */
+
+#if (__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33))
+struct mallinfo2 mallinfo2(void) {
+  struct my_mallinfo2 info = my_mallinfo2();
+  struct mallinfo2 result = {
+    .arena = info.arena,
+    .ordblks = info.ordblks,
+    .smblks = info.smblks,
+    .hblks = info.hblks,
+    .hblkhd = info.hblkhd,
+    .usmblks = info.usmblks,
+    .fsmblks = info.fsmblks,
+    .uordblks = info.uordblks,
+    .fordblks = info.fordblks,
+    .keepcost = info.keepcost,
+  };
+  return result;
+} /* mallinfo2() */
+#endif
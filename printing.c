@@ -19,7 +19,7 @@ static bool use_color;
  * @param block The block to print
  */
 void basic_print(header *block) {
-  printf("[%zd]->", TRUE_SIZE(block));
+  printf("[%zd]->", (size_t) TRUE_SIZE(block));
 }
 
 /**
@@ -28,7 +28,7 @@ void basic_print(header *block) {
  * @param block The block to print
  */
 void print_list(header *block) {
-  printf("[%zd]\n", TRUE_SIZE(block));
+  printf("[%zd]\n", (size_t) TRUE_SIZE(block));
 }
 
 /**
@@ -46,6 +46,12 @@ static inline const char *allocated_to_string(size_t size) {
       return "true";
     case (state) FENCEPOST:
       return "fencepost";
+    case (state) MMAPPED:
+      return "mmapped";
+    case (state) CACHED:
+      return "cached";
+    case (state) QUICK:
+      return "quick";
   }
   assert(false);
 }
@@ -80,6 +86,13 @@ static void print_color(header *block) {
     case (state) FENCEPOST:
       printf("\033[0;33m");
       break;
+    case (state) MMAPPED:
+      printf("\033[0;35m");
+      break;
+    case (state) CACHED:
+    case (state) QUICK:
+      printf("\033[0;36m");
+      break;
   }
 }
 
@@ -109,6 +122,24 @@ void print_pointer(void *p) {
   }
 }
 
+#if OFFSET_LINKS
+
+/**
+ * @brief Print a free list link, an offset from the base of the block's
+ * heap. For arena 0 this matches the relative pointer of the block it
+ * links to.
+ *
+ * @param link The link to print
+ */
+void print_link(uint32_t link) {
+  if (link == 0) {
+    printf("NULLPTR");
+  } else {
+    printf("%04u", (unsigned) link);
+  }
+}
+#endif
+
 /**
  * @brief Verbose printing of all of the metadata fields of each block
  *
@@ -121,11 +152,20 @@ void print_object(header *block) {
   printf("\taddr: ");
   print_pointer(block);
   puts("");
-  printf("\tsize: %zd\n", TRUE_SIZE(block));
-  printf("\tleft_size: %zd\n", block->left_size);
+  printf("\tsize: %zd\n", (size_t) TRUE_SIZE(block));
+  printf("\tleft_size: %zd\n", (size_t) block->left_size);
   printf("\tallocated: %s\n", allocated_to_string(block->size));
   if (!(block->size & (state) ALLOCATED) && 
       !(block->size & (state) FENCEPOST)) {
+#if OFFSET_LINKS
+    printf("\tprev: ");
+    print_link(block->prev_link);
+    puts("");
+
+    printf("\tnext: ");
+    print_link(block->next_link);
+    puts("");
+#else
     printf("\tprev: ");
     print_pointer(block->prev);
     puts("");
@@ -133,6 +173,7 @@ void print_object(header *block) {
     printf("\tnext: ");
     print_pointer(block->next);
     puts("");
+#endif
   }
   printf("]\n");
 
@@ -156,12 +197,21 @@ void print_status(header *block) {
     case (state) FENCEPOST:
       printf("[F]");
       break;
+    case (state) MMAPPED:
+      printf("[M]");
+      break;
+    case (state) CACHED:
+      printf("[C]");
+      break;
+    case (state) QUICK:
+      printf("[Q]");
+      break;
   }
   clear_color();
 }
 
 /**
- * @brief print the full freelist
+ * @brief print every non-empty free list, smallest size class first
  *
  * @param pf Function to perform the header printing
  */
@@ -170,11 +220,30 @@ void freelist_print(printFormatter pf) {
     return;
   }
 
-  header *freelist = g_freelist_head;
-  printf("%p\n%p\n", freelist, freelist->next);
-  do {
-    pf(freelist);
-    puts("");
-  } while ((freelist = freelist->next) != NULL);
+  for (size_t i = 0; i < N_LISTS; i++) {
+    header *freelist = g_freelists[i];
+    if (freelist == NULL) {
+      continue;
+    }
+
+#if OFFSET_LINKS
+
+    /* The printed lists are arena 0's, whose links start at g_base */
+
+    printf("%p\n%p\n", freelist, freelist->next_link == 0 ? NULL :
+           (char *) g_base + freelist->next_link);
+    do {
+      pf(freelist);
+      puts("");
+    } while ((freelist = freelist->next_link == 0 ? NULL :
+              (header *) ((char *) g_base + freelist->next_link)) != NULL);
+#else
+    printf("%p\n%p\n", freelist, freelist->next);
+    do {
+      pf(freelist);
+      puts("");
+    } while ((freelist = freelist->next) != NULL);
+#endif
+  }
   fflush(stdout);
 }
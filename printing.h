@@ -28,5 +28,8 @@ void freelist_print(printFormatter pf);
 
 /* Helpers */
 void print_pointer(void * p);
+#if OFFSET_LINKS
+void print_link(uint32_t link);
+#endif
 
 #endif // PRINTING_H
@@ -0,0 +1,48 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_SIZES (4)
+
+/*
+ * Tests the segregated free lists (built with N_LISTS > 1):
+ *  -freed blocks are filed under the list matching their size
+ *  -a request for that size is served by the head of its list
+ */
+
+int main()
+{
+  size_t sizes[NUM_SIZES] = { 16, 24, 40, 64 };
+  char * arr[NUM_SIZES];
+  char * guards[NUM_SIZES];
+
+  //  Separate each block with a guard so nothing coalesces on free
+  for (int i = 0; i < NUM_SIZES; i++) {
+    arr[i] = (char *) my_malloc(sizes[i]);
+    guards[i] = (char *) my_malloc(sizes[i]);
+    assert(arr[i] != NULL);
+    assert(guards[i] != NULL);
+  }
+
+  for (int i = 0; i < NUM_SIZES; i++) {
+    my_free(arr[i]);
+  }
+  verify_header_count(NUM_SIZES + 1, NUM_SIZES, 2);
+
+  for (int i = 0; i < NUM_SIZES; i++) {
+    header * h = (header *) (arr[i] - ALLOC_HEADER_SIZE);
+    size_t index = (TRUE_SIZE(h) - MIN_BLOCK_SIZE) / MIN_ALLOCATION;
+    assert(index < N_LISTS - 1);
+    assert(g_freelists[index] == h);
+    assert(h->next == NULL);
+  }
+
+  //  Each request should come straight from the head of its list
+  for (int i = NUM_SIZES - 1; i >= 0; i--) {
+    assert(my_malloc(sizes[i]) == arr[i]);
+  }
+  verify_header_count(1, 2 * NUM_SIZES, 2);
+
+  return 0;
+} /* main() */
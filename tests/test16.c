@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+/*
+ * Tests TLSF (FIT_ALGORITHM 5):
+ *  -a request is served from the smallest list guaranteed to fit, even when
+ *   a larger block sits earlier in the heap
+ *  -freeing and reallocating keeps the header counts consistent
+ */
+
+int main()
+{
+  char * large = (char *) my_malloc(100 * sizeof(int));
+  char * guard1 = (char *) my_malloc(sizeof(int));
+  char * small = (char *) my_malloc(12 * sizeof(int));
+  char * guard2 = (char *) my_malloc(sizeof(int));
+
+  assert(large != NULL);
+  assert(guard1 != NULL);
+  assert(small != NULL);
+  assert(guard2 != NULL);
+
+  my_free(large);
+  my_free(small);
+  verify_header_count(3, 2, 2);
+
+  //  The small block is the better fit, even though the large one is
+  //  first in the heap
+  assert(my_malloc(10 * sizeof(int)) == small);
+  verify_header_count(2, 3, 2);
+
+  //  The large block is still whole
+  assert(my_malloc(100 * sizeof(int)) == large);
+  verify_header_count(1, 4, 2);
+
+  my_free(large);
+  my_free(small);
+  my_free(guard1);
+  my_free(guard2);
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_INTS (4)
+
+/*
+ * Frees NUM_INTS small blocks into the thread's cache, then exits
+ */
+
+void *cache_and_exit(void *unused)
+{
+  int * arr[NUM_INTS];
+
+  for (int i = 0; i < NUM_INTS; i++) {
+    arr[i] = (int *) my_malloc(4 * sizeof(int));
+  }
+  for (int i = 0; i < NUM_INTS; i++) {
+    my_free(arr[i]);
+  }
+
+  return NULL;
+} /* cache_and_exit() */
+
+/*
+ * Frees NUM_INTS blocks allocated by the main thread, then exits without
+ * having allocated
+ */
+
+void *free_and_exit(void *arg)
+{
+  int ** arr = (int **) arg;
+
+  for (int i = 0; i < NUM_INTS; i++) {
+    my_free(arr[i]);
+  }
+
+  return NULL;
+} /* free_and_exit() */
+
+#if NUM_ARENAS > 2
+
+/*
+ * Allocates small blocks until one comes from outside the calling thread's
+ * arena, arena 2. Returns that block.
+ */
+
+void *fill_arena(void *unused)
+{
+  int * arr = NULL;
+  char * start = NULL;
+
+  do {
+    arr = (int *) my_malloc(4 * sizeof(int));
+    assert(arr != NULL);
+    start = (char *) g_arenas[2].heap_start;
+  } while (((char *) arr >= start) &&
+           ((char *) arr < start + ARENA_HEAP_SIZE));
+
+  return arr;
+} /* fill_arena() */
+
+#endif
+
+/*
+ * Tests the thread cache (built with THREAD_CACHE_SIZE > 0):
+ *  -a freed small block stays cached (allocated to its neighbors) and is
+ *   handed back by the next request of its size
+ *  -a thread's cache is returned to the heap when the thread exits, even
+ *   if the thread only freed
+ *  -a thread whose arena region is full refills its cache from arena 0
+ *   (built with three arenas)
+ */
+
+int main()
+{
+  int * arr = (int *) my_malloc(4 * sizeof(int));
+  header * h = (header *) (((char *) arr) - ALLOC_HEADER_SIZE);
+
+  my_free(arr);
+  assert((h->size & 0b111) == CACHED);
+
+  assert(my_malloc(4 * sizeof(int)) == arr);
+  assert((h->size & 0b111) == ALLOCATED);
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, cache_and_exit, NULL);
+  pthread_join(thread, NULL);
+
+  //  Only arr (and the blocks still in this thread's cache) remain.
+  //  pthread_create() may have moved the break, so stop at the last fencepost
+  header * walk = (header *) g_base;
+  int cached = 0;
+  do {
+    if ((walk->size & 0b111) == CACHED) {
+      cached++;
+    }
+  } while ((walk = right_neighbor(walk)) < g_last_fence_post);
+  assert(cached == THREAD_CACHE_BATCH - 1);
+
+  int * given[NUM_INTS];
+  for (int i = 0; i < NUM_INTS; i++) {
+    given[i] = (int *) my_malloc(4 * sizeof(int));
+  }
+  size_t cached_before = my_mallinfo2().smblks;
+
+  pthread_create(&thread, NULL, free_and_exit, given);
+  pthread_join(thread, NULL);
+  assert(my_mallinfo2().smblks == cached_before);
+
+#if NUM_ARENAS > 2
+  int * outside = NULL;
+  pthread_create(&thread, NULL, fill_arena, NULL);
+  pthread_join(thread, (void **) &outside);
+  assert((char *) outside >= (char *) g_base);
+  assert((char *) outside < (char *) sbrk(0));
+#endif
+
+  return 0;
+} /* main() */
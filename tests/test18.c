@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+/*
+ * Allocates a block from the calling thread's arena
+ */
+
+void *allocate(void *unused)
+{
+  return my_malloc(16 * sizeof(int));
+} /* allocate() */
+
+/*
+ * Tests multiple arenas (built with NUM_ARENAS = 2):
+ *  -the first two threads are given different arenas
+ *  -a block is freed back into the arena that owns it, whichever thread
+ *   frees it
+ */
+
+int main()
+{
+  int * main_arr = (int *) my_malloc(16 * sizeof(int));
+  verify_header_count(1, 1, 2);
+
+  pthread_t thread;
+  int * thread_arr = NULL;
+  pthread_create(&thread, NULL, allocate, NULL);
+  pthread_join(thread, (void **) &thread_arr);
+
+  //  The second thread allocated from the mmap() region of arena 1
+  assert(thread_arr != NULL);
+  assert(g_arenas[1].heap_start != NULL);
+  assert((char *) thread_arr > g_arenas[1].heap_start);
+  assert((char *) thread_arr < g_arenas[1].heap_start + ARENA_HEAP_SIZE);
+
+  //  Freeing it from this thread coalesces it back into arena 1's chunk
+  my_free(thread_arr);
+  header * h = g_arenas[1].freelists[0];
+  assert(h != NULL);
+  assert(h->next == NULL);
+  assert(TRUE_SIZE(h) == ARENA_SIZE - 3 * ALLOC_HEADER_SIZE);
+
+  //  (pthread_create() may have moved the break, so arena 0 is checked
+  //  through its free list instead of verify_header_count())
+  my_free(main_arr);
+  h = g_freelist_head;
+  assert(h != NULL);
+  assert(h->next == NULL);
+  assert(TRUE_SIZE(h) == ARENA_SIZE - 3 * ALLOC_HEADER_SIZE);
+
+  return 0;
+} /* main() */
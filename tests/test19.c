@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+/*
+ * Tests the mmap() path for large requests:
+ *  -a request at the threshold gets a mapping of its own, tagged MMAPPED,
+ *   and does not grow the heap
+ *  -freeing it does not touch the heap either
+ */
+
+int main()
+{
+  char * arr = (char *) my_malloc(MMAP_THRESHOLD);
+  assert(arr != NULL);
+  assert(sbrk(0) == g_base);
+
+  header * h = (header *) (arr - ALLOC_HEADER_SIZE);
+  assert((h->size & 0b111) == MMAPPED);
+  assert(TRUE_SIZE(h) >= MMAP_THRESHOLD);
+  assert(h->left_size % sysconf(_SC_PAGESIZE) == 0);
+
+  //  The whole block is usable
+  memset(arr, 0xAB, TRUE_SIZE(h));
+
+  my_free(arr);
+  assert(sbrk(0) == g_base);
+
+  //  Smaller requests still come from the heap
+  arr = (char *) my_malloc(MMAP_THRESHOLD / 2);
+  assert(arr != NULL);
+  verify_header_count(1, 1, 2);
+
+  return 0;
+} /* main() */
@@ -0,0 +1,41 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (64)
+
+/*
+ * Tests trimming the top of the heap:
+ *  -freeing enough memory at the top of the heap shrinks the break
+ *  -my_malloc_trim() gives back everything but one ARENA_SIZE chunk
+ *  -the heap grows again (and coalesces) after being trimmed
+ */
+
+int main()
+{
+  char * arr[NUM_BLOCKS];
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(ARENA_SIZE);
+    assert(arr[i] != NULL);
+  }
+  char * grown = (char *) sbrk(0);
+  assert(grown - (char *) g_base >= TRIM_THRESHOLD);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    my_free(arr[i]);
+  }
+  verify_header_count(1, 0, 2);
+  assert((char *) sbrk(0) < grown);
+
+  my_malloc_trim(0);
+  assert((char *) sbrk(0) == (char *) g_base + ARENA_SIZE);
+  verify_header_count(1, 0, 2);
+
+  arr[0] = (char *) my_malloc(4 * ARENA_SIZE);
+  assert(arr[0] != NULL);
+  verify_header_count(1, 1, 2);
+
+  return 0;
+} /* main() */
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+/*
+ * Tests resizing blocks with my_realloc():
+ *  -growing into an unallocated right neighbor keeps the block in place
+ *  -shrinking splits the tail off as a free block
+ *  -a block that cannot grow in place moves and keeps its contents
+ */
+
+int main()
+{
+  char * a = (char *) my_malloc(64);
+  char * b = (char *) my_malloc(256);
+  char * c = (char *) my_malloc(64);
+  memset(a, 'a', 64);
+  my_free(b);
+  verify_header_count(2, 2, 2);
+
+  char * grown = (char *) my_realloc(a, 256);
+  assert(grown == a);
+  for (int i = 0; i < 64; i++) {
+    assert(grown[i] == 'a');
+  }
+  verify_header_count(2, 2, 2);
+
+  char * shrunk = (char *) my_realloc(grown, 32);
+  assert(shrunk == a);
+  for (int i = 0; i < 32; i++) {
+    assert(shrunk[i] == 'a');
+  }
+  verify_header_count(2, 2, 2);
+
+  memset(c, 'c', 64);
+  char * moved = (char *) my_realloc(c, 4096);
+  assert(moved != c);
+  for (int i = 0; i < 64; i++) {
+    assert(moved[i] == 'c');
+  }
+  verify_header_count(2, 2, 2);
+
+  assert(my_realloc(moved, 0) == NULL);
+  assert(my_realloc(shrunk, 0) == NULL);
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
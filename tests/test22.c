@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (16)
+#define BLOCK_SIZE (200)
+#define LARGE_SIZE (512 * 1024)
+
+/*
+ * Tests my_calloc():
+ *  -a count and size whose product overflows fails with ENOMEM
+ *  -reused blocks, and blocks coalesced over old headers, come back zeroed
+ *  -large blocks come back zeroed
+ */
+
+void verify_zero(char * mem, size_t size) {
+  assert(mem != NULL);
+  for (size_t i = 0; i < size; i++) {
+    assert(mem[i] == 0);
+  }
+} /* verify_zero() */
+
+int main()
+{
+  errno = 0;
+  assert(my_calloc(SIZE_MAX / 2, 4) == NULL);
+  assert(errno == ENOMEM);
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_calloc(1, BLOCK_SIZE);
+    verify_zero(arr[i], BLOCK_SIZE);
+    memset(arr[i], 0xff, BLOCK_SIZE);
+  }
+
+  my_free(arr[3]);
+  arr[3] = (char *) my_calloc(BLOCK_SIZE, 1);
+  verify_zero(arr[3], BLOCK_SIZE);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    my_free(arr[i]);
+  }
+  verify_header_count(1, 0, 2);
+
+  char * whole = (char *) my_calloc(NUM_BLOCKS, BLOCK_SIZE);
+  verify_zero(whole, NUM_BLOCKS * BLOCK_SIZE);
+  memset(whole, 0xff, NUM_BLOCKS * BLOCK_SIZE);
+  my_free(whole);
+
+  char * large = (char *) my_calloc(1, LARGE_SIZE);
+  verify_zero(large, LARGE_SIZE);
+  memset(large, 0xff, LARGE_SIZE);
+  my_free(large);
+
+  large = (char *) my_calloc(LARGE_SIZE, 1);
+  verify_zero(large, LARGE_SIZE);
+  my_free(large);
+
+  return 0;
+} /* main() */
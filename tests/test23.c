@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_OBJECTS (1024)
+#define OBJECT_SIZE (48)
+
+/*
+ * Tests the slab allocator:
+ *  -small objects of one size are packed without headers
+ *  -they never touch the heap, while larger requests still do
+ *  -freed objects are reused, and realloc keeps objects that still fit
+ *  -a sized free finds objects whose usable size passes SLAB_MAX_SIZE
+ */
+
+int main()
+{
+  char * arr[NUM_OBJECTS];
+
+  for (int i = 0; i < NUM_OBJECTS; i++) {
+    arr[i] = (char *) my_malloc(OBJECT_SIZE);
+    assert(arr[i] != NULL);
+    memset(arr[i], i, OBJECT_SIZE);
+  }
+  assert(arr[1] - arr[0] == OBJECT_SIZE);
+  assert(sbrk(0) == g_base);
+
+  char * large = (char *) my_malloc(SLAB_MAX_SIZE + 1);
+  verify_header_count(1, 1, 2);
+
+  for (int i = 0; i < NUM_OBJECTS; i++) {
+    for (int j = 0; j < OBJECT_SIZE; j++) {
+      assert(arr[i][j] == (char) i);
+    }
+  }
+
+  char * freed = arr[NUM_OBJECTS / 2];
+  my_free(freed);
+  arr[NUM_OBJECTS / 2] = (char *) my_malloc(OBJECT_SIZE - 4);
+  assert(arr[NUM_OBJECTS / 2] == freed);
+
+  assert(my_realloc(arr[0], OBJECT_SIZE - 8) == arr[0]);
+  char * moved = (char *) my_realloc(arr[1], 4 * OBJECT_SIZE);
+  assert(moved != arr[1]);
+  for (int j = 0; j < OBJECT_SIZE; j++) {
+    assert(moved[j] == 1);
+  }
+  arr[1] = moved;
+
+  for (int i = 0; i < NUM_OBJECTS; i++) {
+    my_free(arr[i]);
+  }
+  my_free(large);
+  verify_header_count(1, 0, 2);
+
+  /* The usable size of the largest objects can pass SLAB_MAX_SIZE */
+
+  char * top = (char *) my_malloc(SLAB_MAX_SIZE);
+  assert(my_malloc_usable_size(top) >= SLAB_MAX_SIZE);
+  my_free_sized(top, my_malloc_usable_size(top));
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
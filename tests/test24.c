@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (64)
+
+/*
+ * Tests the aligned allocation functions:
+ *  -the data is aligned, and the slack in front of it is a free block
+ *  -invalid alignments are rejected
+ *  -large aligned blocks get a mapping of their own that can be resized
+ */
+
+int main()
+{
+  char * page = (char *) my_memalign(4096, 1000);
+  assert(((uintptr_t) page) % 4096 == 0);
+  memset(page, 1, 1000);
+  verify_header_count(2, 1, 2);
+  my_free(page);
+  verify_header_count(1, 0, 2);
+
+  void * mem = NULL;
+  assert(my_posix_memalign(&mem, 24, 100) == EINVAL);
+  assert(my_posix_memalign(&mem, 0, 100) == EINVAL);
+  assert(mem == NULL);
+  errno = 0;
+  assert(my_memalign(48, 100) == NULL);
+  assert(errno == EINVAL);
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    size_t alignment = 16 << (i % 6);
+    assert(my_posix_memalign((void **) &arr[i], alignment, 24 + i) == 0);
+    assert(((uintptr_t) arr[i]) % alignment == 0);
+    memset(arr[i], i, 24 + i);
+  }
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    for (int j = 0; j < 24 + i; j++) {
+      assert(arr[i][j] == i);
+    }
+    my_free(arr[i]);
+  }
+  verify_header_count(1, 0, 2);
+
+  char * large = (char *) my_aligned_alloc(65536, MMAP_THRESHOLD);
+  assert(((uintptr_t) large) % 65536 == 0);
+  memset(large, 2, MMAP_THRESHOLD);
+  large = (char *) my_realloc(large, 2 * MMAP_THRESHOLD);
+  assert(large != NULL);
+  for (int i = 0; i < MMAP_THRESHOLD; i++) {
+    assert(large[i] == 2);
+  }
+  my_free(large);
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
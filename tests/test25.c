@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (16)
+#define BLOCK_SIZE (96)
+
+/*
+ * Tests the batch allocation functions:
+ *  -a batch of heap blocks is carved from one free region
+ *  -freeing the batch coalesces it back into a single free block, also
+ *   when small blocks would otherwise go to a quick list
+ */
+
+int main()
+{
+  void * arr[NUM_BLOCKS];
+
+  assert(my_malloc_batch(BLOCK_SIZE, NUM_BLOCKS, arr) == NUM_BLOCKS);
+  verify_header_count(1, NUM_BLOCKS, 2);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    if (i > 0) {
+      assert((char *) arr[i] - (char *) arr[i - 1] ==
+             BLOCK_SIZE + ALLOC_HEADER_SIZE);
+    }
+    memset(arr[i], i, BLOCK_SIZE);
+  }
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    for (int j = 0; j < BLOCK_SIZE; j++) {
+      assert(((char *) arr[i])[j] == i);
+    }
+  }
+
+  char * other = (char *) my_malloc(BLOCK_SIZE);
+  verify_header_count(1, NUM_BLOCKS + 1, 2);
+
+  my_free_batch(arr, NUM_BLOCKS);
+  verify_header_count(2, 1, 2);
+
+  my_free(other);
+#if QUICK_LIST_CLASSES > 0
+  my_malloc_trim(0);
+#endif
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
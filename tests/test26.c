@@ -0,0 +1,61 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_BLOCKS (256)
+
+/*
+ * Tests the LD_PRELOAD library. This program uses the standard functions
+ * only and is run with libmymalloc.so preloaded:
+ *  -the allocator's symbols are present, so the standard ones are its own
+ *  -malloc(0) returns a unique pointer
+ *  -the standard entry points behave like the C library's
+ */
+
+int main()
+{
+  assert(dlsym(RTLD_DEFAULT, "my_malloc") != NULL);
+  assert(malloc_usable_size(NULL) == 0);
+
+  char * zero = (char *) malloc(0);
+  assert(zero != NULL);
+  free(zero);
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) malloc(i + 1);
+    assert(malloc_usable_size(arr[i]) >= (size_t) i + 1);
+    memset(arr[i], i, i + 1);
+  }
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) realloc(arr[i], 2 * i + 2);
+    for (int j = 0; j <= i; j++) {
+      assert(arr[i][j] == (char) i);
+    }
+    free(arr[i]);
+  }
+
+  int * ints = (int *) calloc(NUM_BLOCKS, sizeof(int));
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    assert(ints[i] == 0);
+  }
+  free(ints);
+
+  void * aligned = NULL;
+  assert(posix_memalign(&aligned, 256, 1000) == 0);
+  assert(((uintptr_t) aligned) % 256 == 0);
+  free(aligned);
+
+  aligned = memalign(64, 100);
+  assert(((uintptr_t) aligned) % 64 == 0);
+  free(aligned);
+
+  printf("Preloaded allocator works\n");
+  return 0;
+} /* main() */
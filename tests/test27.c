@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (32)
+
+/*
+ * Tests my_free_sized() and my_malloc_usable_size():
+ *  -the usable size covers the request, and all of it can be written
+ *  -blocks freed with their requested or usable size coalesce as usual
+ *  -mapped blocks are unmapped by a sized free
+ */
+
+int main()
+{
+  char * arr[NUM_BLOCKS];
+  size_t sizes[NUM_BLOCKS];
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    sizes[i] = 3 * i + 1;
+    arr[i] = (char *) my_malloc(sizes[i]);
+    assert(my_malloc_usable_size(arr[i]) >= sizes[i]);
+    memset(arr[i], i, my_malloc_usable_size(arr[i]));
+  }
+  verify_header_count(1, NUM_BLOCKS, 2);
+
+  for (int i = 0; i < NUM_BLOCKS; i += 2) {
+    my_free_sized(arr[i], sizes[i]);
+  }
+  for (int i = 1; i < NUM_BLOCKS; i += 2) {
+    for (size_t j = 0; j < my_malloc_usable_size(arr[i]); j++) {
+      assert(arr[i][j] == i);
+    }
+    my_free_sized(arr[i], my_malloc_usable_size(arr[i]));
+  }
+  verify_header_count(1, 0, 2);
+
+  char * large = (char *) my_malloc(MMAP_THRESHOLD);
+  assert(my_malloc_usable_size(large) >= MMAP_THRESHOLD);
+  my_free_sized(large, MMAP_THRESHOLD);
+  verify_header_count(1, 0, 2);
+
+  assert(my_malloc_usable_size(NULL) == 0);
+  my_free_sized(NULL, 0);
+
+  return 0;
+} /* main() */
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (8)
+#define BLOCK_SIZE (120)
+
+/*
+ * Tests the allocator statistics:
+ *  -bytes in use follow allocation and free, including mapped blocks
+ *  -free blocks match the heap, and the heap size the OS requests
+ *  -splits and coalesces are counted
+ */
+
+int main()
+{
+  struct my_mallinfo2 info = my_mallinfo2();
+  assert((info.arena == 0) && (info.uordblks == 0) && (info.ordblks == 0));
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(BLOCK_SIZE);
+  }
+
+  info = my_mallinfo2();
+  assert(info.arena == ARENA_SIZE);
+  assert(info.uordblks == NUM_BLOCKS * BLOCK_SIZE);
+  assert(info.ordblks == 1);
+  assert(info.fordblks == ARENA_SIZE - 3 * ALLOC_HEADER_SIZE -
+         NUM_BLOCKS * (BLOCK_SIZE + ALLOC_HEADER_SIZE));
+  assert(info.keepcost == info.fordblks);
+  assert(g_arenas[0].stats.os_requests == 1);
+  assert(g_arenas[0].stats.splits == NUM_BLOCKS);
+
+  /* The first search fails and is repeated once the heap has grown */
+
+  assert(g_arenas[0].stats.fit_searches == NUM_BLOCKS + 1);
+
+  my_free(arr[2]);
+  my_free(arr[4]);
+  info = my_mallinfo2();
+  assert(info.uordblks == (NUM_BLOCKS - 2) * BLOCK_SIZE);
+  assert(info.ordblks == 3);
+  verify_header_count(3, NUM_BLOCKS - 2, 2);
+
+  my_free(arr[3]);
+  assert(g_arenas[0].stats.coalesces == 2);
+
+  char * large = (char *) my_malloc(MMAP_THRESHOLD);
+  info = my_mallinfo2();
+  assert((info.hblks == 1) && (info.hblkhd > MMAP_THRESHOLD));
+  assert(info.uordblks == (NUM_BLOCKS - 3) * BLOCK_SIZE +
+         my_malloc_usable_size(large));
+  my_free(large);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    if ((i < 2) || (i > 4)) {
+      my_free(arr[i]);
+    }
+  }
+  info = my_mallinfo2();
+  assert((info.uordblks == 0) && (info.hblks == 0) && (info.hblkhd == 0));
+  assert(info.ordblks == 1);
+
+  my_malloc_stats();
+  return 0;
+} /* main() */
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (8)
+#define BLOCK_SIZE (120)
+#define LARGE_SIZE (3500)
+
+typedef struct counts {
+  int free;
+  int alloc;
+  int fence;
+} counts;
+
+void count_block(header *block, size_t arena, void *arg)
+{
+  counts *c = (counts *) arg;
+  assert(arena == 0);
+  if (STATE(block) == FENCEPOST) {
+    c->fence++;
+  } else if (STATE(block) == UNALLOCATED) {
+    c->free++;
+  } else {
+    c->alloc++;
+  }
+} /* count_block() */
+
+void verify_walk(int num_free, int num_alloc, int num_fence)
+{
+  counts c = { 0, 0, 0 };
+  my_heap_walk(count_block, &c);
+  assert((c.free == num_free) && (c.alloc == num_alloc) &&
+         (c.fence == num_fence));
+} /* verify_walk() */
+
+void verify_chunk(heap_chunk_report *chunk)
+{
+  assert(chunk->used + chunk->free + 2 * ALLOC_HEADER_SIZE == chunk->size);
+} /* verify_chunk() */
+
+/*
+ * Tests the heap walk and the heap report:
+ *  -the walk visits every header, like verify_header_count()
+ *  -free space, the largest free block and the histogram match the heap
+ *  -a chunk that does not follow the last one is walked and reported
+ */
+
+int main()
+{
+  struct my_heap_report report;
+  my_heap_report(&report);
+  assert((report.chunks == 0) && (report.free_blocks == 0));
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(BLOCK_SIZE);
+  }
+  my_free(arr[2]);
+  my_free(arr[5]);
+  verify_header_count(3, NUM_BLOCKS - 2, 2);
+  verify_walk(3, NUM_BLOCKS - 2, 2);
+
+  my_heap_report(&report);
+  struct my_mallinfo2 info = my_mallinfo2();
+  assert(report.chunks == 1);
+  assert(report.free_blocks == 3);
+  assert(report.free_bytes == info.fordblks);
+  assert(report.largest_free == info.keepcost);
+  assert(report.fragmentation > 0.0);
+  assert(report.fragmentation == 1.0 - (double) report.largest_free /
+                                 report.free_bytes);
+
+  size_t histogram_blocks = 0;
+  for (size_t i = 0; i < sizeof(report.histogram) / sizeof(size_t); i++) {
+    histogram_blocks += report.histogram[i];
+  }
+  assert(histogram_blocks == 3);
+  assert(report.histogram[6] == 2);
+
+  assert(report.chunk[0].start == g_base);
+  assert(report.chunk[0].size == ARENA_SIZE);
+  verify_chunk(&report.chunk[0]);
+
+  /* Move the break so that the next chunk cannot join the first */
+
+  sbrk(ARENA_SIZE);
+  char * large = (char *) my_malloc(LARGE_SIZE);
+  verify_walk(4, NUM_BLOCKS - 1, 4);
+
+  my_heap_report(&report);
+  assert(report.chunks == 2);
+  assert((char *) report.chunk[1].start > (char *) report.chunk[0].start +
+                                          report.chunk[0].size);
+  assert(report.chunk[1].size == ARENA_SIZE);
+  verify_chunk(&report.chunk[0]);
+  verify_chunk(&report.chunk[1]);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    if ((i != 2) && (i != 5)) {
+      my_free(arr[i]);
+    }
+  }
+  my_free(large);
+  verify_walk(2, 0, 4);
+
+  my_heap_report(&report);
+  assert(report.free_blocks == 2);
+  assert(report.chunk[0].used == 0);
+  assert(report.chunk[1].used == 0);
+  assert(report.largest_free == report.chunk[1].free - ALLOC_HEADER_SIZE);
+
+  my_heap_report_print(&report);
+  return 0;
+} /* main() */
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_CALLS (13)
+#define ALIGNMENT (64)
+
+void * ptrs[NUM_CALLS];
+
+void * worker(void * arg)
+{
+  ptrs[0] = my_malloc(100);
+  ptrs[1] = my_calloc(4, 25);
+  ptrs[2] = my_realloc(ptrs[0], 5000);
+  my_free(ptrs[1]);
+  ptrs[4] = my_realloc(NULL, 10);
+  my_free(ptrs[2]);
+  my_free(ptrs[4]);
+  ptrs[7] = my_memalign(ALIGNMENT, 200);
+  assert(my_malloc_batch(16, 2, &ptrs[8]) == 2);
+  my_free_sized(ptrs[7], 200);
+  my_free_batch(&ptrs[8], 2);
+  return NULL;
+} /* worker() */
+
+/*
+ * Tests allocation tracing:
+ *  -each call is recorded once, a moving realloc included, and so are
+ *   aligned, batch and sized calls
+ *  -records hold the op, size, blocks and thread, in time order
+ *  -a thread's records are written out when it exits
+ */
+
+int main()
+{
+  pthread_t thread;
+  pthread_create(&thread, NULL, worker, NULL);
+  pthread_join(thread, NULL);
+
+  trace_record records[NUM_CALLS + 1];
+  int fd = open(MALLOC_TRACE_FILE, O_RDONLY);
+  assert(fd >= 0);
+  assert(read(fd, records, sizeof(records)) ==
+         NUM_CALLS * sizeof(trace_record));
+  close(fd);
+  unlink(MALLOC_TRACE_FILE);
+
+  uint32_t ops[NUM_CALLS] = { TRACE_MALLOC, TRACE_CALLOC, TRACE_REALLOC,
+                              TRACE_FREE, TRACE_REALLOC, TRACE_FREE,
+                              TRACE_FREE, TRACE_MEMALIGN, TRACE_MALLOC,
+                              TRACE_MALLOC, TRACE_FREE, TRACE_FREE,
+                              TRACE_FREE };
+  uint64_t sizes[NUM_CALLS] = { 100, 100, 5000, 0, 10, 0, 0, 200, 16, 16,
+                                0, 0, 0 };
+  for (int i = 0; i < NUM_CALLS; i++) {
+    assert(records[i].op == ops[i]);
+    assert(records[i].size == sizes[i]);
+    assert(records[i].thread == 0);
+    assert((i == 0) || (records[i].time >= records[i - 1].time));
+  }
+
+  assert(records[0].ptr == (uintptr_t) ptrs[0]);
+  assert(records[1].ptr == (uintptr_t) ptrs[1]);
+  assert(records[2].ptr == (uintptr_t) ptrs[2]);
+  assert(records[2].old_ptr == (uintptr_t) ptrs[0]);
+  assert(records[3].ptr == (uintptr_t) ptrs[1]);
+  assert((records[4].ptr == (uintptr_t) ptrs[4]) &&
+         (records[4].old_ptr == 0));
+  assert(records[5].ptr == (uintptr_t) ptrs[2]);
+  assert(records[6].ptr == (uintptr_t) ptrs[4]);
+  assert((records[7].ptr == (uintptr_t) ptrs[7]) &&
+         (records[7].old_ptr == ALIGNMENT));
+  assert(records[8].ptr == (uintptr_t) ptrs[8]);
+  assert(records[9].ptr == (uintptr_t) ptrs[9]);
+  assert(records[10].ptr == (uintptr_t) ptrs[7]);
+  assert(records[11].ptr == (uintptr_t) ptrs[8]);
+  assert(records[12].ptr == (uintptr_t) ptrs[9]);
+  return 0;
+} /* main() */
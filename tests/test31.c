@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (4)
+#define BLOCK_SIZE (100)
+#define THREAD_CALLS (1000)
+
+void * worker(void * arg)
+{
+  for (int i = 0; i < THREAD_CALLS; i++) {
+    my_free(my_malloc(BLOCK_SIZE));
+  }
+  return NULL;
+} /* worker() */
+
+pthread_key_t late_key;
+
+/*
+ * Allocates from a destructor that runs after the allocator's own
+ */
+
+void late_destructor(void * arg)
+{
+  my_free(my_malloc(BLOCK_SIZE));
+} /* late_destructor() */
+
+void * late_worker(void * arg)
+{
+  pthread_setspecific(late_key, arg);
+  my_free(my_malloc(BLOCK_SIZE));
+  return NULL;
+} /* late_worker() */
+
+void verify_summary(latency_summary * s, uint64_t calls)
+{
+  assert(s->calls == calls);
+  assert((s->p50 <= s->p90) && (s->p90 <= s->p99) && (s->p99 <= s->p999) &&
+         (s->p999 <= s->max));
+  assert(s->max > 0);
+} /* verify_summary() */
+
+/*
+ * Tests the latency histograms:
+ *  -every my_malloc() and my_free() call is counted, percentiles in order
+ *  -growing the heap, a full list scan, coalescing both neighbors and
+ *   mapping a block are tagged
+ *  -calls from a thread that has exited are kept until a reset, and calls
+ *   made after its counts were moved are dropped
+ *  -calloc, realloc, the aligned and batch calls are timed on their own,
+ *   without the calls they make
+ */
+
+int main()
+{
+  struct my_latency latency;
+  my_latency_snapshot(&latency);
+  assert((latency.ops[LATENCY_MALLOC].calls == 0) &&
+         (latency.ops[LATENCY_FREE].calls == 0));
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(BLOCK_SIZE);
+  }
+  my_free(arr[0]);
+  my_free(arr[2]);
+  my_free(arr[1]);
+
+  char * large = (char *) my_malloc(ARENA_SIZE);
+  char * mapped = (char *) my_malloc(MMAP_THRESHOLD);
+  my_free(mapped);
+
+  my_latency_snapshot(&latency);
+  verify_summary(&latency.ops[LATENCY_MALLOC], NUM_BLOCKS + 2);
+  verify_summary(&latency.ops[LATENCY_FREE], 4);
+  assert(latency.events[LATENCY_SBRK] == 2);
+  assert(latency.events[LATENCY_FULL_SCAN] == 1);
+  assert(latency.events[LATENCY_COALESCE_BOTH] == 1);
+  assert(latency.events[LATENCY_MMAP] == 2);
+  assert(latency.events[LATENCY_LOCK_WAIT] == 0);
+  assert(latency.event_cycles[LATENCY_SBRK] > 0);
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, worker, NULL);
+  pthread_join(thread, NULL);
+
+  my_latency_snapshot(&latency);
+  verify_summary(&latency.ops[LATENCY_MALLOC],
+                 NUM_BLOCKS + 2 + THREAD_CALLS);
+  verify_summary(&latency.ops[LATENCY_FREE], 4 + THREAD_CALLS);
+  my_latency_print(&latency);
+
+  my_latency_reset();
+  my_latency_snapshot(&latency);
+  assert((latency.ops[LATENCY_MALLOC].calls == 0) &&
+         (latency.ops[LATENCY_FREE].calls == 0) &&
+         (latency.events[LATENCY_SBRK] == 0));
+
+  my_free(large);
+  my_free(arr[3]);
+  my_latency_snapshot(&latency);
+  verify_summary(&latency.ops[LATENCY_FREE], 2);
+
+  pthread_key_create(&late_key, late_destructor);
+  pthread_create(&thread, NULL, late_worker, &late_key);
+  pthread_join(thread, NULL);
+  my_latency_snapshot(&latency);
+  verify_summary(&latency.ops[LATENCY_MALLOC], 1);
+  verify_summary(&latency.ops[LATENCY_FREE], 3);
+
+  my_latency_reset();
+  char * zeroed = (char *) my_calloc(NUM_BLOCKS, BLOCK_SIZE);
+  char * moved = (char *) my_realloc(my_malloc(BLOCK_SIZE), 2 * ARENA_SIZE);
+  char * aligned = (char *) my_memalign(64, BLOCK_SIZE);
+  void * posix = NULL;
+  assert(my_posix_memalign(&posix, 64, BLOCK_SIZE) == 0);
+  char * c11 = (char *) my_aligned_alloc(64, BLOCK_SIZE);
+  void * batch[NUM_BLOCKS];
+  assert(my_malloc_batch(BLOCK_SIZE, NUM_BLOCKS, batch) == NUM_BLOCKS);
+  my_free_batch(batch, NUM_BLOCKS);
+  my_free_sized(zeroed, NUM_BLOCKS * BLOCK_SIZE);
+
+  my_latency_snapshot(&latency);
+  verify_summary(&latency.ops[LATENCY_MALLOC], 1);
+  verify_summary(&latency.ops[LATENCY_FREE], 1);
+  verify_summary(&latency.ops[LATENCY_CALLOC], 1);
+  verify_summary(&latency.ops[LATENCY_REALLOC], 1);
+  verify_summary(&latency.ops[LATENCY_MEMALIGN], 3);
+  verify_summary(&latency.ops[LATENCY_MALLOC_BATCH], 1);
+  verify_summary(&latency.ops[LATENCY_FREE_BATCH], 1);
+  my_latency_print(&latency);
+
+  my_free(moved);
+  my_free(aligned);
+  my_free(posix);
+  my_free(c11);
+  return 0;
+} /* main() */
@@ -0,0 +1,123 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_HOLES (8)
+#define REQUEST (128)
+#define EXACT_HOLE (3)
+
+char * holes[NUM_HOLES];
+
+void find_largest(header * block, size_t arena, void * arg)
+{
+  header ** largest = (header **) arg;
+  header * current = *largest;
+  if ((STATE(block) == UNALLOCATED) &&
+      ((current == NULL) || (TRUE_SIZE(block) > TRUE_SIZE(current)))) {
+    *largest = block;
+  }
+} /* find_largest() */
+
+/* Fit steps are only counted with MALLOC_STATS */
+
+#if MALLOC_STATS
+#define ASSERT_STEPS(x) assert(x)
+#else
+#define ASSERT_STEPS(x) ((void) (x))
+#endif
+
+/*
+ * Returns the fit steps one my_malloc(REQUEST) takes, and frees the block
+ * again
+ */
+
+size_t steps_to_find(char ** found)
+{
+  size_t steps = g_arenas[0].stats.fit_steps;
+  *found = (char *) my_malloc(REQUEST);
+  steps = g_arenas[0].stats.fit_steps - steps;
+  my_free(*found);
+  return steps;
+} /* steps_to_find() */
+
+/*
+ * Tests choosing the fit algorithm at runtime:
+ *  -best, first and worst fit pick different blocks from the same heap
+ *  -unknown parameters and algorithms are refused
+ *  -the adaptive policy moves to best fit when searches miss, to next fit
+ *   when they are long, and back to first fit, also without MALLOC_STATS
+ */
+
+int main()
+{
+  char * separators[NUM_HOLES];
+  for (int i = 0; i < NUM_HOLES; i++) {
+    size_t size = (i == EXACT_HOLE) ? REQUEST : REQUEST + 64 * (i + 1);
+    holes[i] = (char *) my_malloc(size);
+    separators[i] = (char *) my_malloc(16);
+  }
+  for (int i = 0; i < NUM_HOLES; i++) {
+    my_free(holes[i]);
+  }
+
+  /* The top of the heap and every hole fit the request */
+
+  char * found = NULL;
+  assert(my_mallopt(M_FIT_ALGORITHM, 3) == 1);
+  ASSERT_STEPS(steps_to_find(&found) == NUM_HOLES + 1);
+  assert(found == holes[EXACT_HOLE]);
+
+  assert(my_mallopt(M_FIT_ALGORITHM, 1) == 1);
+  char * head = (char *) &g_freelist_head->data;
+  ASSERT_STEPS(steps_to_find(&found) == 1);
+  assert(found == head);
+
+  assert(my_mallopt(M_FIT_ALGORITHM, 4) == 1);
+  header * largest = NULL;
+  my_heap_walk(find_largest, &largest);
+  steps_to_find(&found);
+  assert(found == (char *) &largest->data);
+
+  assert(my_mallopt(M_FIT_ALGORITHM, 5) == 0);
+  assert(my_mallopt(M_FIT_ALGORITHM, -1) == 0);
+  assert(my_mallopt(M_FIT_ALGORITHM + 1, 1) == 0);
+
+  /* Each phase runs two windows of searches, so that the last window to
+   * end in a phase lies wholly within it. Requests larger than any free
+   * block miss, and grow the heap (searching twice) */
+
+  assert(my_mallopt(M_FIT_ALGORITHM, FIT_ADAPTIVE) == 1);
+  char * large[ADAPT_WINDOW];
+  for (int i = 0; i < ADAPT_WINDOW; i++) {
+    large[i] = (char *) my_malloc(2 * ARENA_SIZE);
+  }
+  ASSERT_STEPS(steps_to_find(&found) == NUM_HOLES + 1);
+  assert(found == holes[EXACT_HOLE]);
+
+  /* Best fit looks at every block, so the searches are long */
+
+  for (int i = 0; i < 2 * ADAPT_WINDOW; i++) {
+    steps_to_find(&found);
+  }
+  size_t steps = steps_to_find(&found);
+  ASSERT_STEPS(steps < NUM_HOLES);
+  assert(found != holes[EXACT_HOLE]);
+
+  /* Short searches that all succeed return to first fit */
+
+  for (int i = 0; i < 2 * ADAPT_WINDOW; i++) {
+    steps_to_find(&found);
+  }
+  head = (char *) &g_freelist_head->data;
+  ASSERT_STEPS(steps_to_find(&found) == 1);
+  assert(found == head);
+
+  for (int i = 0; i < ADAPT_WINDOW; i++) {
+    my_free(large[i]);
+  }
+  for (int i = 0; i < NUM_HOLES; i++) {
+    my_free(separators[i]);
+  }
+  return 0;
+} /* main() */
@@ -0,0 +1,88 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (256)
+#define BLOCK_SIZE (ARENA_SIZE / 4)
+#define GROWTH_CAP (16 * ARENA_SIZE)
+
+char * arr[NUM_BLOCKS];
+
+/*
+ * Tests the heap growth policy:
+ *  -bad growth parameters are refused
+ *  -geometric growth doubles each growth up to the cap, and counts the
+ *   calls it makes
+ *  -the top pad and minimum growth are added to a growth
+ *  -the automatic trim keeps the top pad
+ */
+
+int main()
+{
+  assert(my_mallopt(M_GROWTH_PERCENT, -1) == 0);
+  assert(my_mallopt(M_GROWTH_MAX, ARENA_SIZE - 1) == 0);
+  assert(my_mallopt(M_GROWTH_MIN, 0) == 0);
+  assert(my_mallopt(M_GROWTH_TOP_PAD, -1) == 0);
+
+  assert(my_mallopt(M_GROWTH_PERCENT, 200) == 1);
+  assert(my_mallopt(M_GROWTH_MAX, GROWTH_CAP) == 1);
+
+  size_t requests = g_arenas[0].stats.os_requests;
+  size_t calls = g_arenas[0].stats.grow_calls;
+  size_t last = g_arenas[0].last_growth;
+  char * top = (char *) sbrk(0);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(BLOCK_SIZE);
+    assert(arr[i] != NULL);
+
+    if ((char *) sbrk(0) != top) {
+      size_t growth = (char *) sbrk(0) - top;
+      assert(growth == g_arenas[0].last_growth);
+      assert((last == 0) || (growth == 2 * last) ||
+             (growth == GROWTH_CAP));
+      last = growth;
+      top = (char *) sbrk(0);
+    }
+  }
+  assert(last == GROWTH_CAP);
+
+  /* 64 pages fit in 1 + 2 + 4 + 8 + 16 + 16 + 16 + 16 of them */
+
+  requests = g_arenas[0].stats.os_requests - requests;
+  assert(requests <= 8);
+  assert(g_arenas[0].stats.grow_calls - calls == requests);
+
+  /* Each growth below starts from a heap trimmed to its last page */
+
+  assert(my_mallopt(M_GROWTH_PERCENT, 0) == 1);
+  assert(my_mallopt(M_GROWTH_TOP_PAD, 8 * ARENA_SIZE) == 1);
+  assert(my_mallopt(M_GROWTH_MIN, 32 * ARENA_SIZE) == 1);
+
+  my_malloc_trim(0);
+  top = (char *) sbrk(0);
+  char * big = (char *) my_malloc(GROWTH_CAP);
+  assert(big != NULL);
+  assert((char *) sbrk(0) - top == 32 * ARENA_SIZE);
+
+  assert(my_mallopt(M_GROWTH_MIN, ARENA_SIZE) == 1);
+  my_malloc_trim(0);
+  top = (char *) sbrk(0);
+  char * bigger = (char *) my_malloc(24 * ARENA_SIZE);
+  assert(bigger != NULL);
+  assert((char *) sbrk(0) - top >= 32 * ARENA_SIZE);
+
+  /* Freeing the top leaves the pad and up to one page of slack */
+
+  my_free(big);
+  my_free(bigger);
+  size_t top_size = g_arenas[0].last_fence_post->left_size;
+  assert(top_size >= 8 * ARENA_SIZE);
+  assert(top_size < 9 * ARENA_SIZE + MIN_BLOCK_SIZE);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    my_free(arr[i]);
+  }
+  return 0;
+} /* main() */
@@ -0,0 +1,83 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (8)
+#define SMALL (MIN_BLOCK_SIZE)
+#define LARGE (4 * SMALL)
+
+#define STATE_OF(p) ((((header *) (((char *) (p)) - ALLOC_HEADER_SIZE))->size) \
+                     & 0b111)
+
+/*
+ * Tests the quick lists (built with QUICK_LIST_CLASSES > 0):
+ *  -a freed small block stays QUICK (allocated to its neighbors) and is
+ *   handed back by the next request of its size
+ *  -quick blocks are coalesced once a fit search fails, and the merged
+ *   space is used instead of growing the heap
+ *  -the lists are coalesced once they hold more than QUICK_LIST_MAX_BYTES
+ *  -my_malloc_trim() coalesces them before trimming
+ */
+
+int main()
+{
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(SMALL);
+    assert(arr[i] != NULL);
+  }
+  char * guard = (char *) my_malloc(SMALL);
+
+  /* Use up the rest of the chunk so that nothing but the quick blocks can
+   * hold a larger request */
+
+  header * top = (header *) (((char *) guard) + SMALL);
+  char * rest = (char *) my_malloc(TRUE_SIZE(top));
+  assert(rest != NULL);
+  verify_header_count(0, NUM_BLOCKS + 2, 2);
+
+  my_free(arr[1]);
+  assert(STATE_OF(arr[1]) == QUICK);
+  verify_header_count(0, NUM_BLOCKS + 2, 2);
+  assert(my_malloc(SMALL) == arr[1]);
+  assert(STATE_OF(arr[1]) == ALLOCATED);
+  assert(g_arenas[0].stats.quick_hits == 1);
+
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    my_free(arr[i]);
+  }
+  assert(g_arenas[0].quick_blocks == NUM_BLOCKS);
+  assert(my_mallinfo2().smblks == NUM_BLOCKS);
+
+  char * top_before = (char *) sbrk(0);
+  char * large = (char *) my_malloc(LARGE);
+  assert(large == arr[0]);
+  assert((char *) sbrk(0) == top_before);
+  assert(g_arenas[0].quick_blocks == 0);
+  assert(g_arenas[0].stats.consolidations == 1);
+  verify_header_count(1, 3, 2);
+  my_free(large);
+
+  /* Free enough small blocks to pass QUICK_LIST_MAX_BYTES */
+
+  size_t count = 2 * QUICK_LIST_MAX_BYTES / SMALL;
+  char * many[count];
+  for (size_t i = 0; i < count; i++) {
+    many[i] = (char *) my_malloc(SMALL);
+  }
+  for (size_t i = 0; i < count; i++) {
+    my_free(many[i]);
+  }
+  assert(g_arenas[0].stats.consolidations >= 2);
+  assert(g_arenas[0].quick_bytes <= QUICK_LIST_MAX_BYTES);
+
+  my_free(guard);
+  assert(STATE_OF(guard) == QUICK);
+  my_free(rest);
+  my_malloc_trim(0);
+  assert(g_arenas[0].quick_blocks == 0);
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_THREADS (4)
+#define PER_THREAD (64)
+#define BLOCK (64)
+
+#define HEADER_OF(p) ((header *) (((char *) (p)) - ALLOC_HEADER_SIZE))
+
+char * blocks[NUM_THREADS * PER_THREAD];
+pthread_barrier_t barrier;
+
+/*
+ * Returns whether a block lies in the mmap() region of arena 1
+ */
+
+bool in_arena_1(void *p)
+{
+  return ((char *) p >= (char *) g_arenas[1].heap_start) &&
+         ((char *) p < (char *) g_arenas[1].heap_start + ARENA_HEAP_SIZE);
+} /* in_arena_1() */
+
+/*
+ * Takes an arena with one allocation, waits until every other thread has
+ * one too, and then frees this thread's share of blocks, all allocated by
+ * the main thread. Returns non-NULL if the frees were remote.
+ */
+
+void *free_share(void *arg)
+{
+  char ** share = (char **) arg;
+  char * probe = (char *) my_malloc(BLOCK);
+  assert(probe != NULL);
+  pthread_barrier_wait(&barrier);
+
+  my_free(probe);
+  for (int i = 0; i < PER_THREAD; i++) {
+    my_free(share[i]);
+  }
+  return in_arena_1(probe) ? arg : NULL;
+} /* free_share() */
+
+/*
+ * Allocates from this thread's own arena and frees the block again, then
+ * frees one block allocated by the main thread
+ */
+
+void *free_one(void *arg)
+{
+  char * own = (char *) my_malloc(BLOCK);
+  assert(own != NULL);
+  assert(in_arena_1(own));
+  my_free(own);
+  assert((HEADER_OF(own)->size & 0b111) == UNALLOCATED);
+
+  my_free(arg);
+  return NULL;
+} /* free_one() */
+
+/*
+ * Frees one block allocated by the main thread, without allocating first
+ */
+
+void *free_never(void *arg)
+{
+  my_free(arg);
+  return NULL;
+} /* free_never() */
+
+/*
+ * Tests remote frees (built with REMOTE_FREE and two arenas):
+ *  -a thread frees blocks of its own arena under the lock as before
+ *  -a block freed by a thread of another arena is pushed on the arena's
+ *   remote list, still allocated to its neighbors
+ *  -the owner takes the list back the next time it allocates, even when a
+ *   fit is found without it, and reuses the blocks instead of growing
+ *  -a thread that has not allocated yet frees under the lock
+ *  -concurrent pushes lose no blocks, and my_malloc_trim() drains them
+ */
+
+int main()
+{
+  char * first = (char *) my_malloc(BLOCK);
+  char * guard = (char *) my_malloc(BLOCK);
+  char * spare = (char *) my_malloc(BLOCK);
+  header * top = right_neighbor(HEADER_OF(spare));
+  char * rest = (char *) my_malloc(TRUE_SIZE(top));
+  assert((first != NULL) && (guard != NULL) && (spare != NULL));
+  assert(rest != NULL);
+  my_free(spare);
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, free_one, first);
+  pthread_join(thread, NULL);
+  assert(g_arenas[1].stats.remote_frees == 0);
+  assert((HEADER_OF(first)->size & 0b111) == ALLOCATED);
+  assert(g_arenas[0].remote == HEADER_OF(first));
+  assert(g_arenas[0].stats.remote_frees == 1);
+  assert(my_mallinfo2().smblks == 1);
+
+  char * top_before = (char *) sbrk(0);
+  char * again = (char *) my_malloc(BLOCK);
+  assert((again == first) || (again == spare));
+  assert((char *) sbrk(0) == top_before);
+  assert(g_arenas[0].remote == NULL);
+  assert(g_arenas[0].stats.remote_drains == 1);
+  assert(my_mallinfo2().smblks == 0);
+
+  pthread_create(&thread, NULL, free_never, again);
+  pthread_join(thread, NULL);
+  assert((HEADER_OF(again)->size & 0b111) == UNALLOCATED);
+  assert(g_arenas[0].remote == NULL);
+  assert(g_arenas[0].stats.remote_frees == 1);
+
+  for (int i = 0; i < NUM_THREADS * PER_THREAD; i++) {
+    blocks[i] = (char *) my_malloc(BLOCK);
+    assert(blocks[i] != NULL);
+  }
+
+  pthread_t threads[NUM_THREADS];
+  pthread_barrier_init(&barrier, NULL, NUM_THREADS);
+  for (int i = 0; i < NUM_THREADS; i++) {
+    pthread_create(&threads[i], NULL, free_share, &blocks[i * PER_THREAD]);
+  }
+  size_t remote_threads = 0;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    void * remote = NULL;
+    pthread_join(threads[i], &remote);
+    remote_threads += (remote != NULL);
+  }
+  pthread_barrier_destroy(&barrier);
+
+  size_t pushed = 0;
+  for (header * h = g_arenas[0].remote; h != NULL; h = h->next) {
+    pushed++;
+  }
+  assert(pushed == remote_threads * PER_THREAD);
+  assert(g_arenas[0].stats.remote_frees == 1 + remote_threads * PER_THREAD);
+
+  my_malloc_trim(0);
+  assert(g_arenas[0].remote == NULL);
+  assert(my_mallinfo2().smblks == 0);
+
+  my_free(guard);
+  my_free(rest);
+  return 0;
+} /* main() */
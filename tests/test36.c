@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define BLOCK (64)
+
+/*
+ * Allocates and frees a block while the main thread holds the arena's lock
+ */
+
+void *contend(void *unused)
+{
+  char * p = (char *) my_malloc(BLOCK);
+  assert(p != NULL);
+  my_free(p);
+  return unused;
+} /* contend() */
+
+/*
+ * Tests the arena lock's profile:
+ *  -every uncontended acquisition is counted, with no waits
+ *  -a thread that finds the lock held spins, then sleeps until the holder
+ *   releases it, and its wait is counted
+ */
+
+int main()
+{
+  arena_stats * stats = &g_arenas[0].stats;
+
+  size_t acquires = stats->lock_acquires;
+  char * p = (char *) my_malloc(BLOCK);
+  my_free(p);
+  assert(stats->lock_acquires == acquires + 2);
+  assert(stats->lock_waits == 0);
+  assert(stats->lock_wait_cycles == 0);
+
+  pthread_mutex_lock(&g_arenas[0].mutex);
+  pthread_t thread;
+  pthread_create(&thread, NULL, contend, NULL);
+
+  /* Hold the lock far longer than the thread spins */
+
+  struct timespec hold = { 0, 50 * 1000 * 1000 };
+  nanosleep(&hold, NULL);
+  acquires = stats->lock_acquires;
+  pthread_mutex_unlock(&g_arenas[0].mutex);
+  pthread_join(thread, NULL);
+
+  assert(stats->lock_acquires == acquires + 2);
+  assert(stats->lock_waits == 1);
+  assert(stats->lock_spins == 0);
+  assert(stats->lock_wait_cycles > 0);
+
+  return 0;
+} /* main() */
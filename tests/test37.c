@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define SMALL (16)
+#define ODD (SMALL + sizeof(uint32_t))
+#define LARGE (4 * MMAP_THRESHOLD)
+
+#define HEADER_OF(p) ((header *) (((char *) (p)) - ALLOC_HEADER_SIZE))
+
+/*
+ * Tests compact headers (built with COMPACT_HEADER):
+ *  -a header takes 8 bytes, so adjacent small blocks are 8 bytes apart
+ *   beyond their size
+ *  -an allocated block's data runs into its right neighbor's left_size,
+ *   so a 16-byte block holds 20 bytes and takes the place a 20-byte
+ *   object would otherwise need 32 bytes for
+ *  -PREV_INUSE tells whether the left_size is valid, and my_calloc() zeroes
+ *   the borrowed word
+ *  -blocks free and coalesce as before
+ *  -requests over MAX_REQUEST fail with ENOMEM
+ *  -mapped blocks keep their length, and chunks stay linked for the walk
+ *   when they do not follow each other
+ */
+
+int main()
+{
+  assert(ALLOC_HEADER_SIZE == 8);
+  assert(sizeof(header) == 8 + 2 * sizeof(header *));
+
+  char * a = (char *) my_malloc(SMALL);
+  char * b = (char *) my_malloc(ODD);
+  char * c = (char *) my_malloc(ODD);
+  assert(b - a == SMALL + ALLOC_HEADER_SIZE);
+  assert(c - b == SMALL + ALLOC_HEADER_SIZE);
+  assert(my_malloc_usable_size(a) == ODD);
+  assert(my_malloc_usable_size(b) == ODD);
+  verify_header_count(1, 3, 2);
+
+  /* Filling a block leaves its right neighbor's size and state alone */
+
+  assert(HEADER_OF(b)->size & PREV_INUSE);
+  assert(HEADER_OF(c)->size & PREV_INUSE);
+  memset(b, 0xFF, ODD);
+  assert(STATE(HEADER_OF(c)) == ALLOCATED);
+  assert(TRUE_SIZE(HEADER_OF(c)) == SMALL);
+
+  /* A freed block gets its left_size back, and a block reusing it starts
+   * out zeroed up to the right neighbor's size */
+
+  my_free(b);
+  assert(!(HEADER_OF(c)->size & PREV_INUSE));
+  assert(HEADER_OF(c)->left_size == SMALL);
+  verify_header_count(2, 2, 2);
+
+  char * zeroed = (char *) my_calloc(1, ODD);
+  assert(zeroed == b);
+  assert(HEADER_OF(c)->size & PREV_INUSE);
+  for (size_t i = 0; i < ODD; i++) {
+    assert(zeroed[i] == 0);
+  }
+  assert(TRUE_SIZE(HEADER_OF(c)) == SMALL);
+
+  my_free(a);
+  my_free(c);
+  verify_header_count(2, 1, 2);
+  my_free(b);
+  verify_header_count(1, 0, 2);
+
+  errno = 0;
+  assert(my_malloc(MAX_REQUEST + 1) == NULL);
+  assert(errno == ENOMEM);
+  assert(my_memalign(64, MAX_REQUEST) == NULL);
+
+  char * large = (char *) my_malloc(LARGE);
+  assert(large != NULL);
+  header * h = (header *) (large - ALLOC_HEADER_SIZE);
+  assert(STATE(h) == MMAPPED);
+  assert(h->left_size >= LARGE + ALLOC_HEADER_SIZE);
+  assert(my_malloc_usable_size(large) >= LARGE);
+  memset(large, 1, LARGE);
+  my_free(large);
+
+  /* Move the break so that the next chunk starts elsewhere */
+
+  sbrk(ARENA_SIZE);
+  char * far = (char *) my_malloc(2 * ARENA_SIZE);
+  assert(far != NULL);
+
+  struct my_heap_report report;
+  my_heap_report(&report);
+  assert(report.chunks == 2);
+  assert((char *) report.chunk[1].start > (char *) report.chunk[0].start +
+         report.chunk[0].size);
+
+  my_free(far);
+  return 0;
+} /* main() */
@@ -0,0 +1,67 @@
+#include <stdio.h>
+
+#include "test_funcs.h"
+#include "my_malloc.h"
+
+#define NUM_BLOCKS (8)
+#define TINY (1)
+
+#define HEADER_OF(p) ((header *) (((char *) (p)) - ALLOC_HEADER_SIZE))
+
+/*
+ * Tests offset free list links (built with OFFSET_LINKS):
+ *  -a free block needs only 8 bytes for its links, so the smallest blocks
+ *   are 8 bytes apart beyond their header
+ *  -links hold the offset of a block from g_base, 0 ending a list
+ *  -blocks on a list unlink and coalesce from either end and the middle
+ */
+
+int main()
+{
+  assert(MIN_BLOCK_SIZE == 2 * sizeof(uint32_t));
+
+  char * arr[NUM_BLOCKS];
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    arr[i] = (char *) my_malloc(TINY);
+    assert(arr[i] != NULL);
+  }
+  for (int i = 1; i < NUM_BLOCKS; i++) {
+    assert(arr[i] - arr[i - 1] == MIN_BLOCK_SIZE + ALLOC_HEADER_SIZE);
+  }
+  verify_header_count(1, NUM_BLOCKS, 2);
+
+  /* Free every other block, so that none of them coalesce */
+
+  for (int i = 0; i < NUM_BLOCKS; i += 2) {
+    my_free(arr[i]);
+  }
+  verify_header_count(1 + NUM_BLOCKS / 2, NUM_BLOCKS / 2, 2);
+
+  header * newest = HEADER_OF(arr[NUM_BLOCKS - 2]);
+  header * next = HEADER_OF(arr[NUM_BLOCKS - 4]);
+  assert(g_freelists[0] == newest);
+  assert(newest->prev_link == 0);
+  assert(newest->next_link == (uint32_t) ((char *) next - (char *) g_base));
+  assert(next->prev_link == (uint32_t) ((char *) newest - (char *) g_base));
+
+  /* Coalescing takes blocks off the head, the middle and the tail */
+
+  my_free(arr[NUM_BLOCKS - 1]);
+  my_free(arr[3]);
+  my_free(arr[1]);
+  verify_header_count(2, 1, 2);
+  my_free(arr[5]);
+  verify_header_count(1, 0, 2);
+
+  /* The smallest blocks are reused */
+
+  char * first = (char *) my_malloc(TINY);
+  char * second = (char *) my_malloc(TINY);
+  assert(first == arr[0]);
+  assert(second == arr[1]);
+  my_free(first);
+  my_free(second);
+  verify_header_count(1, 0, 2);
+
+  return 0;
+} /* main() */
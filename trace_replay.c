@@ -0,0 +1,314 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "my_malloc.h"
+
+/*
+ * Runs a trace recorded with MALLOC_TRACE against this build of the
+ * allocator, and reports the time the calls took and the memory the heap
+ * needed for them:
+ *
+ *   make replay TRACE=malloc.trace
+ *   ./trace_replay_fit1 malloc.trace
+ *
+ * The calls run on one thread, in the order they were made. Blocks are
+ * numbered as they are allocated, so each call refers to the block the
+ * traced program saw, even once its address has been reused. Calls on
+ * blocks the trace never saw allocated are skipped.
+ *
+ * The replay's own memory is mapped directly, so that it stays out of the
+ * heap being measured.
+ */
+
+#define NO_BLOCK (UINT32_MAX)
+
+/* How many calls run between samples of the heap's size */
+
+#define SAMPLE_INTERVAL (4096)
+
+/* A trace record with its place in the file, to keep the order of records
+ * with the same time */
+
+typedef struct timed_record {
+  trace_record record;
+  size_t position;
+} timed_record;
+
+/* A call, with the numbers of the blocks it returns and is passed */
+
+typedef struct replay_op {
+  uint32_t op;
+  uint32_t block;
+  uint32_t old_block;
+  size_t size;
+  size_t alignment;
+} replay_op;
+
+/* The blocks allocated at an address and not yet freed, oldest first.
+ * A block moved by my_realloc() is traced once the call returns, so its
+ * old address can be handed out again before then */
+
+typedef struct address_entry {
+  uint64_t address;
+  uint32_t first;
+  uint32_t last;
+} address_entry;
+
+static address_entry *g_addresses = NULL;
+static size_t g_address_mask = 0;
+static uint32_t *g_next_block = NULL;
+
+/*
+ * Maps zeroed memory, exiting if there is none.
+ */
+
+static void *map_memory(size_t size) {
+  void *mem = mmap(NULL, size == 0 ? 1 : size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  return mem;
+} /* map_memory() */
+
+static int compare_records(const void *a, const void *b) {
+  const timed_record *x = (const timed_record *) a;
+  const timed_record *y = (const timed_record *) b;
+  if (x->record.time != y->record.time) {
+    return x->record.time < y->record.time ? -1 : 1;
+  }
+  return x->position < y->position ? -1 : (x->position > y->position);
+} /* compare_records() */
+
+/*
+ * Returns the table entry for an address, claiming an empty one if the
+ * address has not been seen.
+ */
+
+static address_entry *find_address(uint64_t address) {
+  size_t i = (size_t) ((address >> 4) * 0x9e3779b97f4a7c15ULL);
+  for (i &= g_address_mask; ; i = (i + 1) & g_address_mask) {
+    address_entry *entry = &g_addresses[i];
+    if (entry->address == address) {
+      return entry;
+    }
+    if (entry->address == 0) {
+      entry->address = address;
+      entry->first = NO_BLOCK;
+      entry->last = NO_BLOCK;
+      return entry;
+    }
+  }
+} /* find_address() */
+
+static void push_block(uint64_t address, uint32_t block) {
+  address_entry *entry = find_address(address);
+  g_next_block[block] = NO_BLOCK;
+  if (entry->last == NO_BLOCK) {
+    entry->first = block;
+  }
+  else {
+    g_next_block[entry->last] = block;
+  }
+  entry->last = block;
+} /* push_block() */
+
+static uint32_t pop_block(uint64_t address) {
+  address_entry *entry = find_address(address);
+  uint32_t block = entry->first;
+  if (block != NO_BLOCK) {
+    entry->first = g_next_block[block];
+    if (entry->first == NO_BLOCK) {
+      entry->last = NO_BLOCK;
+    }
+  }
+  return block;
+} /* pop_block() */
+
+/*
+ * Turns the sorted records into calls on numbered blocks. Returns the
+ * number of blocks, and the most bytes the program had requested at once.
+ */
+
+static uint32_t number_blocks(timed_record *records, size_t count,
+                              replay_op *ops, size_t *peak_requested) {
+  size_t table_size = 16;
+  while (table_size < 2 * count) {
+    table_size *= 2;
+  }
+  g_addresses = map_memory(table_size * sizeof(address_entry));
+  g_address_mask = table_size - 1;
+  g_next_block = map_memory(count * sizeof(uint32_t));
+  size_t *sizes = map_memory(count * sizeof(size_t));
+
+  uint32_t blocks = 0;
+  size_t requested = 0;
+  *peak_requested = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    trace_record *r = &records[i].record;
+    replay_op *op = &ops[i];
+    op->op = r->op;
+    op->size = (size_t) r->size;
+    op->alignment = r->op == TRACE_MEMALIGN ? (size_t) r->old_ptr : 0;
+    op->block = NO_BLOCK;
+    op->old_block = NO_BLOCK;
+
+    /* A failed my_realloc() leaves the old block where it was */
+
+    if ((r->op == TRACE_REALLOC) && (r->ptr == 0) && (r->size != 0)) {
+      continue;
+    }
+
+    if (((r->op == TRACE_REALLOC) || (r->op == TRACE_FREE)) &&
+        (r->op == TRACE_FREE ? r->ptr : r->old_ptr) != 0) {
+      op->old_block = pop_block(r->op == TRACE_FREE ? r->ptr : r->old_ptr);
+      if (op->old_block != NO_BLOCK) {
+        requested -= sizes[op->old_block];
+      }
+    }
+
+    if ((r->op != TRACE_FREE) && (r->ptr != 0)) {
+      op->block = blocks++;
+      sizes[op->block] = op->size;
+      push_block(r->ptr, op->block);
+      requested += op->size;
+      if (requested > *peak_requested) {
+        *peak_requested = requested;
+      }
+    }
+  }
+  return blocks;
+} /* number_blocks() */
+
+/*
+ * Returns the bytes the heap has taken from the OS, mapped blocks
+ * included.
+ */
+
+static size_t heap_footprint(void) {
+  struct my_mallinfo2 info = my_mallinfo2();
+  return info.arena + info.hblkhd;
+} /* heap_footprint() */
+
+static double seconds_since(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+} /* seconds_since() */
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s trace\n", argv[0]);
+    return 1;
+  }
+
+  int fd = open(argv[1], O_RDONLY);
+  struct stat st;
+  if ((fd < 0) || (fstat(fd, &st) != 0)) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  size_t count = st.st_size / sizeof(trace_record);
+  timed_record *records = map_memory(count * sizeof(timed_record));
+  if (count > 0) {
+    trace_record *file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                              0);
+    if (file == MAP_FAILED) {
+      perror(argv[1]);
+      return 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+      records[i].record = file[i];
+      records[i].position = i;
+    }
+    munmap(file, st.st_size);
+  }
+  close(fd);
+
+  qsort(records, count, sizeof(timed_record), compare_records);
+
+  replay_op *ops = map_memory(count * sizeof(replay_op));
+  size_t peak_requested = 0;
+  uint32_t blocks = number_blocks(records, count, ops, &peak_requested);
+  void **ptrs = map_memory(blocks * sizeof(void *));
+
+  /* Only the calls are timed, not the samples of the heap's size */
+
+  double seconds = 0.0;
+  size_t peak_footprint = 0;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (size_t i = 0; i < count; i++) {
+    replay_op *op = &ops[i];
+    void *old = op->old_block == NO_BLOCK ? NULL : ptrs[op->old_block];
+
+    switch (op->op) {
+      case TRACE_MALLOC:
+        if (op->block != NO_BLOCK) {
+          ptrs[op->block] = my_malloc(op->size);
+        }
+        break;
+      case TRACE_CALLOC:
+        if (op->block != NO_BLOCK) {
+          ptrs[op->block] = my_calloc(1, op->size);
+        }
+        break;
+      case TRACE_MEMALIGN:
+        if (op->block != NO_BLOCK) {
+          ptrs[op->block] = my_memalign(op->alignment, op->size);
+        }
+        break;
+      case TRACE_REALLOC:
+        if ((op->block != NO_BLOCK) || (op->size == 0)) {
+          void *mem = my_realloc(old, op->size);
+          if (op->block != NO_BLOCK) {
+            ptrs[op->block] = mem;
+          }
+        }
+        break;
+      case TRACE_FREE:
+        my_free(old);
+        break;
+    }
+
+    if ((i + 1) % SAMPLE_INTERVAL == 0) {
+      seconds += seconds_since(&start);
+      size_t footprint = heap_footprint();
+      if (footprint > peak_footprint) {
+        peak_footprint = footprint;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+  }
+  seconds += seconds_since(&start);
+  if (heap_footprint() > peak_footprint) {
+    peak_footprint = heap_footprint();
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("fit %d: %zu calls on %u blocks in %.3f s (%.1f ns per call)\n",
+         FIT_ALGORITHM, count, blocks, seconds,
+         count == 0 ? 0.0 : seconds * 1e9 / count);
+  printf("  peak requested   = %12zu\n", peak_requested);
+  printf("  peak footprint   = %12zu (%.2f times requested)\n",
+         peak_footprint, peak_requested == 0 ? 0.0 :
+         (double) peak_footprint / peak_requested);
+  printf("  peak RSS         = %12ld KB\n", usage.ru_maxrss);
+  return 0;
+} /* main() */